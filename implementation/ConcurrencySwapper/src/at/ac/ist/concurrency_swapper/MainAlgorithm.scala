@@ -23,15 +23,15 @@ import ac.at.ist.concurrency_swapper.z3formulas.{Z3Helper, Z3TheoremProver, Z3Fo
 import helpers._
 import helpers.After
 import helpers.PlaceAtomicSectionFunction
-import modelchecker.CtexStmt
-import modelchecker.poirot.InvokePoirot
+import modelchecker.{BugSignature, CtexStmt}
+import modelchecker.poirot.{CheckerTimeout, InvokePoirot}
 import org.sosy_lab.cpachecker.cfa.objectmodel.{CFAEdge, CFAFunctionDefinitionNode}
 import java.io._
 import scala.Some
 import org.sosy_lab.common.configuration.Configuration
 import org.sosy_lab.common.LogManager
-import structures.{Structure,Function}
-import translation.Down
+import structures.{Structure,Function,FunctionCallStatement}
+import translation.{TranslationChain, Down}
 import z3.scala.{Z3Context, Z3Config}
 import org.sosy_lab.cpachecker.cfa.{CFA, CFACreator}
 import collection.mutable.ListBuffer
@@ -42,15 +42,21 @@ import scala.collection.mutable.Map
 
 object MainAlgorithm {
   val advancedPrinting = false
+  var hierarchicalSearch = false // search on the level of blocks first and refine the region that fixed the bug
+  var pipelined = false // prepare the next candidates while the model checker runs
+  val pipelineDepth = 3 // how many candidates are prepared ahead
+  var timeBudget = 0.0 // seconds after which we return the best candidate so far (0 means no limit)
+  var moverWorkers = 0 // threads that compute the mover relation before the search (0 means it is computed lazily)
 
   type stmts = List[StatementOrder.Statement]
 
   // we return the correct program, number of iterations and time it took in seconds
-  // then we return the poirotTime
+  // then we return the poirotTime and a report of the bugs that remain (empty if the program is correct)
+  // if a recipe is given it is replayed first and the search only starts if the replayed program is not correct
   def algorithm(threads : List[(CFAFunctionDefinitionNode, String)],
                 otherFunctions : List[(CFAFunctionDefinitionNode, String)],
-                originalProgram:String, filename:String)
-          : (String,Int,Double,Double) = {
+                originalProgram:String, filename:String, recipe:List[StableConstraint] = List.empty)
+          : (StatementOrder,Int,Double,Double,String) = {
 
     val folder = filename.substring(0,filename.length-2)
     val dir = new File(folder)
@@ -66,17 +72,57 @@ object MainAlgorithm {
     val formulaLog = new BufferedWriter(new OutputStreamWriter(new FileOutputStream("output/formulalog.txt"),"UTF-16"))
     var iteration = 0
     Down.deadlockAnalysis = false
-    ParallelAnalysis.MoverCache.clear
+    ParallelAnalysis.Movers.clear()
+    TranslationChain.clearFormulas()
+    Independence.reset()
+    ConcreteExecution.reset()
+    PersistentMoverCache.hits.set(0)
+    PersistentMoverCache.equivalentHits.set(0)
+    ParallelAnalysis.reducedWidthRefutations.set(0)
+    Z3TheoremProver.wins.clear()
     val startDate = new Date()
     var poirotTime = 0.0
-    var previousBugid = 0 // this variable holds the bug id of the last bug to see if we fixed something
+    var previousBugid : BugSignature = null // this variable holds the signature of the last bug to see if we fixed something
+    var bugOrigin : StatementOrder = null // the candidate in which the current bug showed up first
 
     var phiList = List(new StatementOrder(threads, otherFunctions, originalProgram))
-    while (phiList != List.empty)
-    {
-      val phi = phiList.head
-      phiList = phiList.tail
-      val (currentProgram,_) = phi.printProgram(PrintType.Poirot)
+    if (moverWorkers > 0)
+      MoverMatrix.compute(phiList.head, moverWorkers, InitWorker _)
+    var lastCtex : List[CtexStmt] = List.empty // the next candidates were derived from this one
+    val pipeline = if (pipelined) new CandidatePipeline(pipelineDepth, InitWorker _) else null
+
+    // for the anytime mode we keep the candidate that fixed most bugs (and among those the cheapest fix)
+    val knownBugs = new collection.mutable.LinkedHashMap[BugSignature, String] // bug -> failing line
+    var fixedBugs : Set[BugSignature] = Set.empty
+    var best : StatementOrder = null
+    var bestFixed = -1
+    var bestOpen : List[String] = List.empty // the bugs still known to be in the best candidate
+
+    def elapsed = ((new Date()).getTime - startDate.getTime) / 1000.0
+
+    def anytimeResult(reason: String) : (StatementOrder,Int,Double,Double,String) = {
+      println(reason + ", returning the best candidate so far")
+      if (pipeline != null) pipeline.shutdown()
+      formulaLog.close()
+      val report = new StringBuilder
+      report.append(reason + ". Best candidate fixed " + bestFixed + " bug(s) with a fix cost of " + best.getFixCost + ".\n")
+      if (bestOpen.isEmpty)
+        report.append("No bugs remain, but the deadlock analysis did not finish.\n")
+      else {
+        report.append("Remaining known bugs:\n")
+        for (b <- bestOpen) report.append("  " + b + "\n")
+      }
+      (best, iteration, elapsed, poirotTime, report.result())
+    }
+
+    // prints the candidate, writes it to the output folder and model checks it
+    def check(phi: StatementOrder) : (Boolean, List[CtexStmt], BugSignature) = {
+      // once there is a candidate to fall back to, the budget also bounds the model checker, a candidate it could not
+      // finish counts as a dead end and the search loop returns the best candidate
+      val budgeted = timeBudget > 0 && best != null
+      if (budgeted && elapsed > timeBudget)
+        return (false, null, null)
+      InvokePoirot.deadline = if (budgeted) startDate.getTime + (timeBudget * 1000).toLong else 0
       iteration += 1
       // let's print the order
       phi.printOrder("output")
@@ -89,27 +135,138 @@ object MainAlgorithm {
       writer.write(phi.printProgram(PrintType.Poirot)._1)
       writer.close()
 
-      val (ok, ctex,bugid,time) = modelCheck(originalProgram, phi)
+      if (pipeline != null) pipeline.start(phiList, lastCtex)
+      val (ok, ctex,bugid,time) = try modelCheck(originalProgram, phi) catch {
+        case e: CheckerTimeout =>
+          if (pipeline != null) pipeline.stop()
+          println("Stopped. (Time budget of " + timeBudget + "s exhausted)")
+          return (false, null, null)
+      }
+      if (pipeline != null) pipeline.stop()
       poirotTime += time
       if (!ok && ctex == null) {
         // the ctex was not ok, we will not continue from here
         println("Done. (Dead End) (Poirot Time: " + time + "s)")
+      } else if(!ok) {
+        println("Done. (Ctex length: "+ctex.length+" lines) (Poirot Time: " + time + "s)")
+        if (advancedPrinting) println("Ctex: " + ctex)
       } else {
-        if(!ok) {
-          println("Done. (Ctex length: "+ctex.length+" lines) (Poirot Time: " + time + "s)")
-          if (advancedPrinting) println("Ctex: " + ctex)
-        } else {
-          println("Done. (Poirot Time: " + time + "s)")
-        }
-        if (previousBugid != 0 && previousBugid != bugid) {
+        println("Done. (Poirot Time: " + time + "s)")
+      }
+      (ok, ctex, bugid)
+    }
+
+    // in hierarchical mode we remember for each coarse candidate where it came from and which statement level
+    // constraints it stands for, the statement level candidates are only searched if all coarse ones fail
+    val refinements = new collection.mutable.HashMap[StatementOrder, (StatementOrder, List[Constraint[Structure]])]
+    var fallbackList : List[StatementOrder] = List.empty
+
+    // tries the statement level constraints of the winning region and returns the first that makes the same progress
+    def refine(parent: StatementOrder, fine: List[Constraint[Structure]], ok: Boolean, bugid: BugSignature)
+          : Option[(StatementOrder, List[CtexStmt])] = {
+      println("Refining the winning region (" + fine.length + " statement level candidates)")
+      for (c <- fine; child <- parent.integrate(List(c))) {
+        val (ok2, ctex2, bugid2) = check(child)
+        if (ok2 == ok && bugid2 == bugid && (ok2 || ctex2 != null))
+          return Some((child, ctex2))
+      }
+      None
+    }
+
+    // the result of checking the replayed program, the search continues from its counterexample without checking again
+    var replayCheck : (StatementOrder, (Boolean, List[CtexStmt], BugSignature)) = null
+    // the functions of the recipe constraints that no longer matched, constraints in them are tried first
+    var replayFocus : Set[String] = Set.empty
+
+    // after a partial replay the missing fixes are most likely where the recipe no longer fits
+    def prioritise(psi: List[Constraint[Structure]]) : List[Constraint[Structure]] = {
+      if (replayFocus.isEmpty) return psi
+      val (near, far) = psi.partition {
+        case After(a, b) => replayFocus.contains(a.getFunctionName()) || replayFocus.contains(b.getFunctionName())
+        case PlaceAtomicSectionFunction(f) => replayFocus.contains(f.getName())
+        case _ => false
+      }
+      near ++ far
+    }
+
+    // apply what still fits of the recipe and verify it once with the deadlock analysis (which checks all assertions)
+    if (!recipe.isEmpty) {
+      val (replayed, unmatched) = FixRecipe.apply(phiList.head, recipe)
+      println("Applied " + (recipe.length - unmatched.length) + " of " + recipe.length + " recipe constraints")
+      for (sc <- unmatched) println("  No longer matches: " + sc)
+      Down.deadlockAnalysis = true
+      val result = check(replayed)
+      if (result._1) {
+        if (pipeline != null) pipeline.shutdown()
+        formulaLog.close()
+        return (replayed, iteration, elapsed, poirotTime, "")
+      }
+      println("The replayed program is not correct yet, searching for the missing fixes")
+      // the deadlock analysis stays on, the counterexample we have was found with it
+      replayCheck = (replayed, result)
+      replayFocus = unmatched.flatMap {
+        case StableAfter(first, second) => List(first.function, second.function)
+        case StableAtomicSection(function) => List(function)
+      }.toSet
+      phiList = List(replayed)
+    }
+
+    while (phiList != List.empty || fallbackList != List.empty)
+    {
+      if (phiList == List.empty) {
+        println("No coarse fix found, continuing with statement level candidates")
+        phiList = fallbackList
+        fallbackList = List.empty
+      }
+      if (timeBudget > 0 && best != null && elapsed > timeBudget)
+        return anytimeResult("Time budget of " + timeBudget + "s exhausted")
+      var phi = phiList.head
+      phiList = phiList.tail
+      val (currentProgram,_) = phi.printProgram(PrintType.Poirot)
+      var (ok, ctex, bugid) = if (replayCheck != null && (replayCheck._1 eq phi)) replayCheck._2 else check(phi)
+      replayCheck = null
+      if (!ok && ctex == null) {
+        // the ctex was not ok, we will not continue from here
+      } else {
+        if (previousBugid != null && previousBugid != bugid) {
+          refinements.get(phi) match {
+            case Some((parent, fine)) if !fine.isEmpty =>
+              refine(parent, fine, ok, bugid) match {
+                case Some((finePhi, fineCtex)) =>
+                  phi = finePhi
+                  ctex = fineCtex
+                case None => ()
+              }
+            case _ => ()
+          }
           phiList = List.empty // we don't consider previous alternatives because we work on a new bug no
+          fallbackList = List.empty
+          refinements.clear()
+          fixedBugs += previousBugid
           println("Fixed one bug in iteration " + iteration)
         }
+        val newBug = previousBugid != bugid
+        if (newBug) {
+          // remember what it took to fix the previous bug
+          if (previousBugid != null && bugOrigin != null)
+            BugDatabase.record(previousBugid, phi.getHistory.drop(bugOrigin.getHistory.length))
+          bugOrigin = phi
+        }
         previousBugid = bugid
+        if (!ok && !knownBugs.contains(bugid))
+          knownBugs(bugid) = ctex.find(_.getAssertionFailure) match {
+            case Some(line) => line.toString.trim
+            case None => bugid.toString
+          }
+        if (fixedBugs.size > bestFixed || (fixedBugs.size == bestFixed && phi.getFixCost < best.getFixCost)) {
+          best = phi
+          bestFixed = fixedBugs.size
+          bestOpen = knownBugs.filterKeys(b => !fixedBugs.contains(b)).values.toList
+        }
         if (ok && Down.deadlockAnalysis) {
+          if (pipeline != null) pipeline.shutdown()
           formulaLog.close()
-          val seconds = ((new Date()).getTime - startDate.getTime) / 1000.0
-          return (phi.printProgram(PrintType.Normal)._1, iteration, seconds, poirotTime)
+          return (phi, iteration, elapsed, poirotTime, "")
         }
         if (ok) {
           Down.deadlockAnalysis = true
@@ -117,19 +274,95 @@ object MainAlgorithm {
           phiList = List(phi)
         } else {
           printCtex(ctex,iteration, folder)
-          val psi = analyseCtex(ctex, phi, formulaLog)
-          //phiList = phi.integrate(psi) ++ phiList
-          phiList = phiList ++ phi.integrate(psi)
+          lastCtex = ctex
+          val psi = prioritise(analyseCtex(ctex, phi, formulaLog))
+          if (hierarchicalSearch) {
+            val coarse = coarsen(psi)
+            for ((c, fine) <- coarse; child <- phi.integrate(List(c))) {
+              refinements(child) = (phi, fine)
+              phiList = phiList ++ List(child)
+            }
+            // the coarse constraints that were already statement level constraints are not tried twice
+            fallbackList = fallbackList ++ phi.integrate(psi.filterNot(c => coarse.exists(_._1 == c)))
+          } else {
+            //phiList = phi.integrate(psi) ++ phiList
+            phiList = phiList ++ phi.integrate(psi)
+          }
+          // if we have seen this bug before we try the fix that worked back then first
+          if (newBug)
+            BugDatabase.applyKnownFix(bugid, phi) match {
+              case Some(known) =>
+                println("Trying the known fix for this bug first")
+                phiList = known :: phiList
+              case None => ()
+            }
           phiList.filter(so => so.printProgram(PrintType.Poirot)._1 != currentProgram)
         }
       }
     }
     println("We ran out of reorderings without getting a correct program")
+    if (timeBudget > 0 && best != null)
+      return anytimeResult("Ran out of reorderings")
+    if (pipeline != null) pipeline.shutdown()
     formulaLog.close()
     return null // this instruction is never executed
   }
 
-  private def modelCheck(program : String, so: StatementOrder) : (Boolean, List[CtexStmt],Int,Double) = {
+  // Hierarchical search: the statement level constraints are lifted to whole blocks and call sites first. Reorderings
+  // of blocks directly inside a function and atomic sections over whole functions are the coarse candidates, every
+  // other constraint inside the blocks (or function) of a coarse candidate becomes part of its region and is only
+  // tried when refining a coarse candidate that fixed the bug.
+  def coarsen(psi: List[Constraint[Structure]]) : List[(Constraint[Structure], List[Constraint[Structure]])] = {
+    // the call site of a function that is called from exactly one place
+    def callSite(f: Function) : Option[Structure] = {
+      val sites = new ListBuffer[Structure]
+      f.getProgramLevel().processAllStructuresByOne {
+        case c: FunctionCallStatement if c.functionCalled().getName() == f.getName() => sites += c; true
+        case _ => true
+      }
+      if (sites.length == 1) Some(sites.head) else None
+    }
+
+    // the block of s inside f, statements of called functions are replaced by their call site
+    def liftInto(s: Structure, f: Function) : Option[Structure] = {
+      var str = s
+      var visited = Set.empty[String]
+      while (str.getFunctionName() != f.getName()) {
+        val g = str.getFunctionLevel()
+        if (visited.contains(g.getName())) return None // recursion
+        visited += g.getName()
+        callSite(g) match {
+          case Some(c) => str = c
+          case None => return None
+        }
+      }
+      Some(str.getBlockLevel())
+    }
+
+    def lift(c: Constraint[Structure]) : Option[Constraint[Structure]] = c match {
+      case After(a, b) =>
+        val lifted = for (f <- List(b.getFunctionLevel(), a.getFunctionLevel()); x <- liftInto(a, f); y <- liftInto(b, f))
+          yield After(x, y)
+        lifted.headOption.filter(l => l.first.getNumber != l.second.getNumber)
+      case PlaceAtomicSectionFunction(_) => Some(c)
+      case _ => None
+    }
+
+    def within(c: Constraint[Structure], region: Constraint[Structure]) : Boolean = (c, region) match {
+      case (After(a, b), After(x, y)) =>
+        val (ab, bb) = (a.getBlockLevel(), b.getBlockLevel())
+        lift(c) == Some(region) ||
+          ab.getNumber == bb.getNumber && (ab.getNumber == x.getNumber || ab.getNumber == y.getNumber)
+      case (After(a, _), PlaceAtomicSectionFunction(f)) =>
+        a.getFunctionLevel().getName() == f.getName() && a.getBlockLevel().getNumber != a.getNumber
+      case _ => false
+    }
+
+    val coarse = psi.flatMap(lift).distinct
+    coarse.map(region => (region, psi.filter(c => c != region && within(c, region))))
+  }
+
+  private def modelCheck(program : String, so: StatementOrder) : (Boolean, List[CtexStmt],BugSignature,Double) = {
     InvokePoirot.invokeChecker(so)
   }
 
@@ -195,16 +428,14 @@ object MainAlgorithm {
 
     // Returns a partial order
     def generalizeCtex(ctex : List[CtexStmt]) : (List[CtexStmt], Set[(Int, Int)]) = {
-      val po = (for(x <- ctex.indices; y <- ctex.indices; if (x < y)) yield {
-        ((x, y))
-      }).toSet;
-      val rpo = po.filter{
-        case (x,y) => {
-          (ctex(x).getThread != ctex(y).getThread &&
-            // !ParallelAnalysis.IsRightMover(ctex(x).getStatement, ctex(y).getStatement, out))
-            !ParallelAnalysis.IsLeftMover(ctex(y).getStatement, ctex(x).getStatement, out))
-        }
-      };
+      val c = ctex.toIndexedSeq
+      // x < y stays ordered if they are in different threads and y is no left mover over x
+      // (instead of asking if x is no right mover over y)
+      val rpo = (for (y <- c.indices) yield {
+        val xs = (0 until y).filter(x => c(x).getThread != c(y).getThread)
+        val nonMovers = ParallelAnalysis.NonMovers(c(y).getStatement, xs.map(c(_).getStatement), false, out)
+        nonMovers.toList.map(i => (xs(i), y))
+      }).flatten.toSet
       // println("Remaining constraints: ")
       // for((x, y) <- rpo)
       //   println(ctex(x) + " < " + ctex(y));
@@ -372,26 +603,12 @@ object MainAlgorithm {
 
     // checks how many statements stmt can be moved to the right
     def moveRight(stmt:stmts, stmtlist:List[stmts]) : Int = {
-      var res = 0
-      for (s<-stmtlist) {
-        if (ParallelAnalysis.IsRightMover(stmt, s, out))
-          res += 1
-        else
-          return res
-      }
-      return res
+      return ParallelAnalysis.MoverPrefix(stmt, stmtlist, true, out)
     }
 
     // checks how many statements stmt can me moved to the left
     def moveLeft(stmt:stmts, stmtlist:List[stmts]) : Int = {
-      var res = 0
-      for (s<- stmtlist.reverse) {
-        if (ParallelAnalysis.IsLeftMover(stmt, s, out))
-          res += 1
-        else
-          return res
-      }
-      return res
+      return ParallelAnalysis.MoverPrefix(stmt, stmtlist.reverse, false, out)
     }
 
     // last return value is the rest list of items
@@ -513,7 +730,8 @@ object MainAlgorithm {
     return primeConstraints.result ++ secondConstraints.result
   }
 
-  def processFile(creator:CFACreator, originalFile:String, newFile:String) = {
+  // the recipe of a complete fix is written next to newFile, replayRecipe names a recipe to try first (or null)
+  def processFile(creator:CFACreator, originalFile:String, newFile:String, replayRecipe:String = null) = {
     println("Processing file " + originalFile)
     // read file from string
     val reader = new FileInputStream(originalFile)
@@ -532,16 +750,40 @@ object MainAlgorithm {
       }
     }
 
-    val res = algorithm(funcs.result(), otherFuncs.result(), originalProgram, originalFile)
+    val recipe = if (replayRecipe != null) FixRecipe.read(replayRecipe) else List.empty
+    // the cache file is closed even if the run fails, so no buffered results are lost
+    val res = try algorithm(funcs.result(), otherFuncs.result(), originalProgram, originalFile, recipe)
+      finally PersistentMoverCache.close()
     if (res != null)
     {
-      val (newProgram, iterations, time, poirotTime) = res
-      val writer = new BufferedWriter(new OutputStreamWriter(new FileOutputStream(newFile)));
-      writer.write(newProgram)
+      val (newSo, iterations, time, poirotTime, report) = res
+      // a partial fix goes to its own file, so newFile only ever holds a correct program
+      val partialFile = newFile.stripSuffix(".c") + "-partial.c"
+      val outFile = if (report.isEmpty) newFile else partialFile
+      new File(if (report.isEmpty) partialFile else newFile).delete()
+      val writer = new BufferedWriter(new OutputStreamWriter(new FileOutputStream(outFile)));
+      writer.write(newSo.printProgram(PrintType.Normal)._1)
       writer.close()
 
-      println("Wrote correct program to " + newFile)
+      if (report.isEmpty) {
+        println("Wrote correct program to " + newFile)
+        // only a complete fix is worth replaying
+        val recipeFile = newFile.stripSuffix(".c") + ".recipe"
+        FixRecipe.write(recipeFile, newSo.getHistory)
+        println("Wrote fix recipe to " + recipeFile)
+      } else {
+        println("Wrote partially fixed program to " + outFile)
+        print(report)
+      }
       println("Iterations: " + iterations + ", Time : " + time, "s, Percent in Poirot: " + poirotTime/time*100 + "%")
+      println("Mover checks answered without z3: " + Independence.hits.get + " of " + Independence.queries.get +
+        " independent, " + ConcreteExecution.hits.get + " of " + ConcreteExecution.queries.get + " refuted concretely (" +
+        ConcreteExecution.learnedHits.get + " with learned states, " + ParallelAnalysis.reducedWidthRefutations.get +
+        " after a check at reduced width), " +
+        PersistentMoverCache.hits.get + " checks answered by the same earlier query and " +
+        PersistentMoverCache.equivalentHits.get + " by one that only differs in variable names (" +
+        PersistentMoverCache.size + " keys in the mover cache)")
+      println("Checks decided by solver strategy: " + Z3TheoremProver.statistics)
     } else {
       println("Failed")
     }
@@ -551,13 +793,27 @@ object MainAlgorithm {
   def main(args: Array[String]) {
     val creator = Init
 
-    processFile(creator, args(0), "output/correctProgram.c")
+    val (options, files) = args.partition(_.startsWith("-"))
+    var replayRecipe : String = null
+    for (o <- options) o match {
+      case "-hierarchical" => hierarchicalSearch = true
+      case "-pipelined" => pipelined = true
+      case b if b.startsWith("-budget=") => timeBudget = b.stripPrefix("-budget=").toDouble
+      case r if r.startsWith("-replay=") => replayRecipe = r.stripPrefix("-replay=")
+      case m if m.startsWith("-movercache=") => PersistentMoverCache.filename = m.stripPrefix("-movercache=")
+      case "-precompute" => moverWorkers = Runtime.getRuntime.availableProcessors
+      case p if p.startsWith("-precompute=") => moverWorkers = p.stripPrefix("-precompute=").toInt
+      case w if w.startsWith("-reducedwidth=") => ParallelAnalysis.reducedWidth = w.stripPrefix("-reducedwidth=").toInt
+      case t if t.startsWith("-solvertimeout=") => Z3TheoremProver.timeoutMs = t.stripPrefix("-solvertimeout=").toInt
+      case b if b.startsWith("-solverbudget=") => Z3TheoremProver.budgetMs = b.stripPrefix("-solverbudget=").toInt
+      case s if s.startsWith("-strategies=") => Z3TheoremProver.quantifierFreeStrategies = s.stripPrefix("-strategies=").split(";").toList
+      case _ => println("Unknown option " + o)
+    }
+    processFile(creator, files(0), "output/correctProgram.c", replayRecipe)
   }
 
 
   def Init:CFACreator = {
-    var cpaConfig: Configuration = null
-    var logManager: LogManager = null
     val config: Configuration.Builder = Configuration.builder
     cpaConfig = config.build
     logManager = new LogManager(cpaConfig)
@@ -574,6 +830,22 @@ object MainAlgorithm {
 
   var fm: Z3FormulaManager = null
   var prover: Z3TheoremProver = null
+  private var cpaConfig: Configuration = null
+  private var logManager: LogManager = null
+
+  // gives the calling thread its own z3 context, formula manager and prover (for the mover precomputation and the
+  // candidate pipeline)
+  def InitWorker() {
+    val ctx = new Z3Context(Z3Helper.getEmptyConfig)
+    val workerFm = new Z3FormulaManager(ctx)
+    val workerProver = new Z3TheoremProver(ctx)
+    workerProver.init
+    GatedCommand.Init(workerFm, true)
+    FormulaHelpers.Init(workerFm, true)
+    StateFormula.Init(workerFm, cpaConfig, logManager, true)
+    ParallelAnalysis.Init(workerFm, workerProver, true)
+  }
+
   private def Init(cpaConfig: Configuration, logManager: LogManager) {
     GatedCommand.Init(fm)
     FormulaHelpers.Init(fm)
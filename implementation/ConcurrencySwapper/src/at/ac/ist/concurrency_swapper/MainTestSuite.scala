@@ -19,9 +19,29 @@ You should have received a copy of the GNU General Public License
 
 package at.ac.ist.concurrency_swapper
 
-import java.io.{FileFilter, File}
+import java.io.{FileInputStream, FileFilter, File}
+import helpers.Helpers
+import org.sosy_lab.cpachecker.cfa.CFACreator
 
 object MainTestSuite {
+  // the options besides the default search, each is switched on for one run and off again afterwards
+  // (the budget is large enough that it never runs out on the test files)
+  val modes: List[(String, Boolean => Unit)] = List(
+    ("hierarchical", b => MainAlgorithm.hierarchicalSearch = b),
+    ("pipelined", b => MainAlgorithm.pipelined = b),
+    ("budget", b => MainAlgorithm.timeBudget = if (b) 3600 else 0))
+
+  // the fix written to file, or null if the run did not find a correct program
+  private def run(creator: CFACreator, file: String, newFile: String, replayRecipe: String = null): String = {
+    new File(newFile).delete()
+    MainAlgorithm.processFile(creator, file, newFile, replayRecipe)
+    if (!new File(newFile).exists) return null
+    val reader = new FileInputStream(newFile)
+    val program = Helpers.readToString(reader)
+    reader.close()
+    program
+  }
+
   def main(args: Array[String]) {
     val creator = MainAlgorithm.Init
 
@@ -31,8 +51,24 @@ object MainTestSuite {
       def accept(p1: File): Boolean = {p1.getName().endsWith(".c") && !p1.getName.contains("correct")}
     });
 
+    var failures = List.empty[String]
     for (f <- listOfFiles) {
-      MainAlgorithm.processFile(creator, f.getName, f.getName.replace(".c","-corrected.c"))
+      val newFile = f.getName.replace(".c","-corrected.c")
+      val expected = run(creator, f.getName, newFile)
+      if (expected != null) {
+        // every option has to find a correct program, replaying the recipe has to give the same one
+        for ((name, set) <- modes) {
+          set(true)
+          val fix = try run(creator, f.getName, f.getName.replace(".c", "-corrected-" + name + ".c")) finally set(false)
+          if (fix == null) failures ::= f.getName + " (" + name + "): no correct program"
+          else if (fix != expected) println(f.getName + " (" + name + "): found a different fix than the default search")
+        }
+        val replayed = run(creator, f.getName, f.getName.replace(".c", "-corrected-replay.c"), newFile.stripSuffix(".c") + ".recipe")
+        if (replayed != expected) failures ::= f.getName + " (replay): the replayed fix differs from the recorded one"
+      }
     }
+
+    for (failure <- failures.reverse) println("FAILED: " + failure)
+    if (!failures.isEmpty) sys.exit(1)
   }
 }
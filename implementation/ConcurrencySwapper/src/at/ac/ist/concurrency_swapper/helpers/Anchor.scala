@@ -0,0 +1,85 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import at.ac.ist.concurrency_swapper.structures.{Function, Structure, Program}
+import collection.mutable.ListBuffer
+
+// Identifies a statement (or block) by its function and its printed text instead of its number,
+// numbers depend on the order of parsing while this stays the same between runs and revisions of the code.
+// Structures with the same text in one function are told apart by their occurrence (counted in source order).
+case class Anchor(function: String, text: String, occurrence: Int = 0)
+
+object Anchor {
+  def normalize(text: String) = text.replaceAll("\\s+", " ").trim
+
+  // the structures of f with this text, ordered by number (which follows the source)
+  private def occurrences(f: Function, text: String): List[Structure] = {
+    val res = new ListBuffer[Structure]
+    f.processAllStructuresByOne(s => {
+      if (s != f && normalize(s.toString) == text)
+        res += s
+      true
+    })
+    res.result().sortBy(_.getNumber)
+  }
+
+  def of(s: Structure): Anchor = {
+    val f = s.getFunctionLevel()
+    val text = normalize(s.toString)
+    Anchor(f.getName(), text, math.max(0, occurrences(f, text).indexWhere(_.getNumber == s.getNumber)))
+  }
+
+  // finds the structure in the program that matches the anchor
+  def find(program: Program, a: Anchor): Option[Structure] = {
+    program.getFunctions().get(a.function) match {
+      case None => None
+      case Some(f) => occurrences(f, a.text).lift(a.occurrence)
+    }
+  }
+}
+
+// a constraint expressed with anchors, it can be applied to any program that contains the anchored statements
+sealed abstract class StableConstraint {
+  def resolve(program: Program): Option[Constraint[Structure]]
+}
+
+case class StableAfter(first: Anchor, second: Anchor) extends StableConstraint {
+  def resolve(program: Program): Option[Constraint[Structure]] = {
+    (Anchor.find(program, first), Anchor.find(program, second)) match {
+      case (Some(f), Some(s)) if Structure.isSameLevel(f, s) => Some(new After[Structure](f, s))
+      case _ => None
+    }
+  }
+}
+
+case class StableAtomicSection(function: String) extends StableConstraint {
+  def resolve(program: Program): Option[Constraint[Structure]] = {
+    program.getFunctions().get(function).map(f => new PlaceAtomicSectionFunction[Structure](f))
+  }
+}
+
+object StableConstraint {
+  def of(c: Constraint[Structure]): Option[StableConstraint] = c match {
+    case After(first, second) => Some(StableAfter(Anchor.of(first), Anchor.of(second)))
+    case PlaceAtomicSectionFunction(f) => Some(StableAtomicSection(f.getName()))
+    case _ => None
+  }
+}
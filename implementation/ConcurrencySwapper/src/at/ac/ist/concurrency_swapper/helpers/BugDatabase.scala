@@ -0,0 +1,49 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import collection.mutable
+import at.ac.ist.concurrency_swapper.modelchecker.BugSignature
+import at.ac.ist.concurrency_swapper.structures.Structure
+
+// Remembers which constraints fixed a bug, so that the fix is tried first when the bug shows up again
+// (in a later iteration, in the deadlock phase or in another file processed in the same run)
+object BugDatabase {
+  private val fixes = new mutable.HashMap[BugSignature, List[StableConstraint]]
+
+  def record(bug: BugSignature, fix: List[Constraint[Structure]]) {
+    val stable = fix.flatMap(StableConstraint.of(_))
+    if (!stable.isEmpty && stable.length == fix.length)
+      fixes(bug) = stable
+  }
+
+  // the candidate that applies the known fix of this bug to so, if there is one and it still fits the program
+  def applyKnownFix(bug: BugSignature, so: StatementOrder): Option[StatementOrder] = {
+    fixes.get(bug) match {
+      case None => None
+      case Some(stable) =>
+        val resolved = stable.map(_.resolve(so.getProgram))
+        if (resolved.contains(None))
+          None
+        else
+          so.integrateAll(resolved.map(_.get))
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import java.util.concurrent.{TimeUnit, ThreadFactory, Executors}
+import at.ac.ist.concurrency_swapper.modelchecker.CtexStmt
+
+// While the model checker works on one candidate this prepares the ones that are checked next:
+// their programs are printed (which also sorts them according to their partial order) and the mover
+// queries for the statements of the last counterexample are discharged so that the next analysis finds them cached.
+// Everything here runs on one worker thread with its own z3 context (set up by initWorker), so the main thread
+// never waits for it: stop only tells the worker to give up, a query it is still in finishes in the background
+// and goes to the mover store like any other.
+// The orders of the candidates of the next counterexample are not built ahead, they depend on its analysis.
+class CandidatePipeline(depth: Int, initWorker: () => Unit) {
+  private val executor = Executors.newSingleThreadExecutor(new ThreadFactory {
+    def newThread(r: Runnable): Thread = {
+      val t = new Thread(new Runnable {
+        def run() {
+          initWorker()
+          try r.run() finally ParallelAnalysis.ReleaseThread()
+        }
+      }, "CandidatePipeline")
+      t.setDaemon(true)
+      t
+    }
+  })
+  // every start gets a new generation, the work of older generations is dropped
+  @volatile private var generation = 0
+
+  // starts preparing the next candidates, hints is the counterexample the candidates were derived from
+  def start(candidates: List[StatementOrder], hints: List[CtexStmt]) {
+    stop()
+    val mine = generation
+    executor.execute(new Runnable {
+      def run() {
+        def stopped = generation != mine
+        try {
+          for (so <- candidates.take(depth); if !stopped)
+            so.stage()
+          warmMovers(hints, stopped)
+        } catch {
+          // the main thread redoes whatever failed here, so this is only worth a note
+          case e: Exception => println("Pipeline: " + e)
+        }
+      }
+    })
+  }
+
+  // tells the worker to stop preparing, without waiting for it
+  def stop() {
+    generation += 1
+  }
+
+  // at the end of a run we do wait, the next run starts with a new mover store that the worker must not write to
+  def shutdown() {
+    stop()
+    executor.shutdown()
+    executor.awaitTermination(Long.MaxValue, TimeUnit.SECONDS)
+  }
+
+  // the statements of the previous counterexample are most likely to show up in the next one. generalizeCtex asks
+  // for left movers over earlier statements of other threads and moveRight/moveLeft for the same pairs, one query
+  // answers both directions of a pair, so every unordered pair of statements of different threads is asked once
+  private def warmMovers(hints: List[CtexStmt], stopped: => Boolean) {
+    val c = hints.toIndexedSeq
+    for (y <- c.indices; x <- 0 until y; if !stopped && c(x).getThread != c(y).getThread)
+      ParallelAnalysis.IsLeftMover(c(y).getStatement, c(x).getStatement, null)
+  }
+}
@@ -0,0 +1,193 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import java.util.concurrent.atomic.AtomicInteger
+import collection.mutable
+import scala.util.Random
+import org.sosy_lab.cpachecker.cfa.ast._
+import org.sosy_lab.cpachecker.cfa.ast.IASTBinaryExpression.BinaryOperator
+import org.sosy_lab.cpachecker.cfa.ast.IASTUnaryExpression.UnaryOperator
+import org.sosy_lab.cpachecker.cfa.objectmodel.{CFAEdgeType, CFAEdge}
+import org.sosy_lab.cpachecker.cfa.objectmodel.c.AssumeEdge
+import at.ac.ist.concurrency_swapper.structures.Statement
+import at.ac.ist.concurrency_swapper.translation.{TranslationChain, AtomicStart, AtomicEnd, Assume, Assert}
+
+// Refutes mover queries by running both orders on a few concrete states. The edges are the ones the formulas are
+// built from (after the lock translation) and the arithmetic is 32 bit like in z3, so if the runs disagree z3
+// would disagree as well. Everything we do not understand (pointers, calls, division, ...) leaves the query to z3.
+// States that told two orders apart (found here or taken from a counter model of z3) are learned and tried first
+// on later queries that read the same variables: a write to x that did not commute with a guard on x at some value
+// usually does not commute with other guards on x at that value either.
+object ConcreteExecution {
+  val queries = new AtomicInteger(0) // how often we were asked
+  val hits = new AtomicInteger(0) // how often we refuted without z3
+  val learnedHits = new AtomicInteger(0) // how many of those were found with a learned state
+  val trials = 8
+  private val maxLearned = 256
+  private var learned : List[Map[String, Int]] = List.empty // most recent first
+
+  def reset() {
+    queries.set(0)
+    hits.set(0)
+    learnedHits.set(0)
+  }
+
+  // remembers a state (variable as named in the formulas -> value) on which two orders differed
+  def learn(state: Map[String, Int]) = synchronized {
+    if (!state.isEmpty && !learned.contains(state))
+      learned = (state :: learned).take(maxLearned)
+  }
+
+  private class Unsupported extends Exception
+
+  private class State(init: mutable.Map[String, Int], gen: () => Int) {
+    val values = new mutable.HashMap[String, Int]
+    def read(v: String) = values.getOrElse(v, init.getOrElseUpdate(v, gen()))
+    def write(v: String, x: Int) { values(v) = x }
+  }
+
+  // the outcome of a run: an assertion failed (the gate is false), an assume blocked, or the final state
+  private abstract class Outcome
+  private case object Failed extends Outcome
+  private case object Blocked extends Outcome
+  private case class Done(values: Map[String, Int]) extends Outcome
+
+  // the same scoping as the formulas
+  private def name(id: IASTIdExpression, function: String): String = {
+    ExpressionHelpers.variableName(id, function) match {
+      case Some(n) => n
+      case None => throw new Unsupported
+    }
+  }
+
+  private def bool(b: Boolean) = if (b) 1 else 0
+
+  private def eval(e: IASTRightHandSide, st: State, function: String): Int = e match {
+    case id: IASTIdExpression => st.read(name(id, function))
+    case l: IASTIntegerLiteralExpression => l.getValue.intValue
+    case u: IASTUnaryExpression =>
+      val v = eval(u.getOperand, st, function)
+      u.getOperator match {
+        case UnaryOperator.MINUS => -v
+        case UnaryOperator.NOT => bool(v == 0)
+        case UnaryOperator.TILDE => ~v
+        case _ => throw new Unsupported
+      }
+    case b: IASTBinaryExpression =>
+      val v1 = eval(b.getOperand1, st, function)
+      val v2 = eval(b.getOperand2, st, function)
+      b.getOperator match {
+        case BinaryOperator.PLUS => v1 + v2
+        case BinaryOperator.MINUS => v1 - v2
+        case BinaryOperator.MULTIPLY => v1 * v2
+        case BinaryOperator.BINARY_AND => v1 & v2
+        case BinaryOperator.BINARY_OR => v1 | v2
+        case BinaryOperator.BINARY_XOR => v1 ^ v2
+        case BinaryOperator.EQUALS => bool(v1 == v2)
+        case BinaryOperator.NOT_EQUALS => bool(v1 != v2)
+        case BinaryOperator.LESS_THAN => bool(v1 < v2)
+        case BinaryOperator.LESS_EQUAL => bool(v1 <= v2)
+        case BinaryOperator.GREATER_THAN => bool(v1 > v2)
+        case BinaryOperator.GREATER_EQUAL => bool(v1 >= v2)
+        case BinaryOperator.LOGICAL_AND => bool(v1 != 0 && v2 != 0)
+        case BinaryOperator.LOGICAL_OR => bool(v1 != 0 || v2 != 0)
+        case _ => throw new Unsupported // division and shifts are left to z3
+      }
+    case _ => throw new Unsupported
+  }
+
+  private def run(edges: List[CFAEdge], init: mutable.Map[String, Int], gen: () => Int): Outcome = {
+    val st = new State(init, gen)
+    for (edge <- edges) {
+      val function = if (edge.getPredecessor != null) edge.getPredecessor.getFunctionName else null
+      if (AtomicStart.accepts(edge) || AtomicEnd.accepts(edge) || edge.getEdgeType == CFAEdgeType.BlankEdge) {
+        // nothing to do
+      } else if (edge.getEdgeType == CFAEdgeType.AssumeEdge) {
+        val a = edge.asInstanceOf[AssumeEdge]
+        if ((eval(a.getExpression, st, function) != 0) != a.getTruthAssumption) return Blocked
+      } else if (Assume.accepts(edge)) {
+        if (eval(ExpressionHelpers.getFunctionDef(edge).get._2, st, function) == 0) return Blocked
+      } else if (Assert.accepts(edge)) {
+        if (eval(ExpressionHelpers.getFunctionDef(edge).get._2, st, function) == 0) return Failed
+      } else edge.getRawAST match {
+        case a: IASTExpressionAssignmentStatement if a.getLeftHandSide.isInstanceOf[IASTIdExpression] =>
+          val v = eval(a.getRightHandSide, st, function)
+          st.write(name(a.getLeftHandSide.asInstanceOf[IASTIdExpression], function), v)
+        case _ => throw new Unsupported
+      }
+    }
+    Done(st.values.toMap)
+  }
+
+  private val boundaries = Array(0, 1, -1, 2, Int.MaxValue, Int.MinValue)
+
+  // Some(true) if c1 is certainly not simulated by c2 (see GatedCommand.Simulates): on some state the gate of c2
+  // holds but the one of c1 does not, or c1 reaches a state c2 cannot reach. None if we cannot run the statements.
+  def refutes(c1: List[Statement], c2: List[Statement]): Option[Boolean] = {
+    queries.incrementAndGet
+    try {
+      val e1 = c1.flatMap(TranslationChain.formulaEdges)
+      val e2 = c2.flatMap(TranslationChain.formulaEdges)
+      def trial(init: mutable.HashMap[String, Int], gen: () => Int): Boolean = {
+        val r2 = run(e2, init, gen)
+        val r1 = run(e1, init, gen)
+        r2 != Failed && (r1 match {
+          case Failed => true
+          case Done(s1) => r2 match {
+            case Done(s2) => (s1.keySet ++ s2.keySet).exists(v =>
+              s1.getOrElse(v, init.getOrElseUpdate(v, gen())) != s2.getOrElse(v, init.getOrElseUpdate(v, gen())))
+            case _ => true
+          }
+          case _ => false
+        })
+      }
+      def found(init: mutable.HashMap[String, Int]) = {
+        hits.incrementAndGet
+        learn(init.toMap)
+        Some(true)
+      }
+
+      // the first state is all 0, it also tells us which variables are read
+      val first = new mutable.HashMap[String, Int]
+      if (trial(first, () => boundaries(0))) return found(first)
+      val read = first.keySet
+      for (state <- synchronized { learned }; if state.keys.exists(read.contains)) {
+        val init = new mutable.HashMap[String, Int] ++= state.filterKeys(read.contains)
+        if (trial(init, () => 0)) {
+          learnedHits.incrementAndGet
+          return found(init)
+        }
+      }
+      // then uniform states (all 1, all -1) and states that mix boundaries and small numbers
+      val random = new Random(c1.length * 31 + c2.length)
+      for (t <- 1 until trials) {
+        val gen: () => Int =
+          if (t < 3) () => boundaries(t)
+          else () => if (random.nextBoolean()) boundaries(random.nextInt(boundaries.length)) else random.nextInt(17) - 8
+        val init = new mutable.HashMap[String, Int]
+        if (trial(init, gen)) return found(init)
+      }
+      Some(false)
+    } catch {
+      case e: Unsupported => None
+    }
+  }
+}
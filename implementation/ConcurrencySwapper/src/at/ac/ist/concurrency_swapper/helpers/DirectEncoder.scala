@@ -0,0 +1,124 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import org.sosy_lab.cpachecker.cfa.ast._
+import org.sosy_lab.cpachecker.cfa.ast.IASTBinaryExpression.BinaryOperator
+import org.sosy_lab.cpachecker.cfa.ast.IASTUnaryExpression.UnaryOperator
+import org.sosy_lab.cpachecker.cfa.objectmodel.{CFAEdgeType, CFAEdge}
+import org.sosy_lab.cpachecker.util.predicates.interfaces.Formula
+
+// Encodes the simple statements directly into the normalized form of StateFormula.fromEdge (reads at index 0,
+// the assigned variable at index 1) instead of building a path formula with CtoFormulaConverter and shifting the
+// indexes afterwards. It covers assignments to and conditions over non-pointer variables with integer literals,
+// arithmetic, bit operations, comparisons and logical operators. The operators are the ones of the formula
+// manager, so the meaning is the same as with CPAchecker. Everything else gives None and is converted as before.
+object DirectEncoder {
+  private class Unsupported extends Exception
+
+  // an assignment statement as a state formula
+  def fromEdge(edge: CFAEdge): Option[StateFormula] = {
+    if (edge.getEdgeType != CFAEdgeType.StatementEdge) return None
+    val function = if (edge.getPredecessor != null) edge.getPredecessor.getFunctionName else null
+    try {
+      edge.getRawAST match {
+        case a: IASTExpressionAssignmentStatement if a.getLeftHandSide.isInstanceOf[IASTIdExpression] =>
+          val lhs = fm.makeVariable(name(a.getLeftHandSide.asInstanceOf[IASTIdExpression], function), 1)
+          Some(new StateFormula(fm.makeAssignment(lhs, value(a.getRightHandSide, function)), 0, 1))
+        case _ => None
+      }
+    } catch {
+      case e: Unsupported => None
+    }
+  }
+
+  // a condition (of an assume or assert) as a formula over index 0
+  def condition(expr: IASTExpression, function: String): Option[Formula] = {
+    try {
+      Some(cond(expr, function))
+    } catch {
+      case e: Unsupported => None
+    }
+  }
+
+  private def name(id: IASTIdExpression, function: String): String = {
+    ExpressionHelpers.variableName(id, function) match {
+      case Some(n) => n
+      case None => throw new Unsupported
+    }
+  }
+
+  private def value(e: IASTRightHandSide, function: String): Formula = e match {
+    case id: IASTIdExpression => fm.makeVariable(name(id, function), 0)
+    case l: IASTIntegerLiteralExpression => fm.makeNumber(l.getValue.intValue)
+    case u: IASTUnaryExpression => u.getOperator match {
+      case UnaryOperator.MINUS => fm.makeNegate(value(u.getOperand, function))
+      case UnaryOperator.TILDE => fm.makeBitwiseNot(value(u.getOperand, function))
+      case UnaryOperator.NOT => asValue(cond(u, function))
+      case _ => throw new Unsupported
+    }
+    case b: IASTBinaryExpression =>
+      val v1 = () => value(b.getOperand1, function)
+      val v2 = () => value(b.getOperand2, function)
+      b.getOperator match {
+        case BinaryOperator.PLUS => fm.makePlus(v1(), v2())
+        case BinaryOperator.MINUS => fm.makeMinus(v1(), v2())
+        case BinaryOperator.MULTIPLY => fm.makeMultiply(v1(), v2())
+        case BinaryOperator.DIVIDE => fm.makeDivide(v1(), v2())
+        case BinaryOperator.MODULO => fm.makeModulo(v1(), v2())
+        case BinaryOperator.BINARY_AND => fm.makeBitwiseAnd(v1(), v2())
+        case BinaryOperator.BINARY_OR => fm.makeBitwiseOr(v1(), v2())
+        case BinaryOperator.BINARY_XOR => fm.makeBitwiseXor(v1(), v2())
+        case BinaryOperator.SHIFT_LEFT => fm.makeShiftLeft(v1(), v2())
+        case BinaryOperator.SHIFT_RIGHT => fm.makeShiftRight(v1(), v2())
+        case _ => asValue(cond(b, function)) // comparisons and logical operators are 0 or 1
+      }
+    case _ => throw new Unsupported
+  }
+
+  private def asValue(c: Formula): Formula = fm.makeIfThenElse(c, fm.makeNumber(1), fm.makeNumber(0))
+
+  private def cond(e: IASTRightHandSide, function: String): Formula = e match {
+    case u: IASTUnaryExpression if u.getOperator == UnaryOperator.NOT => fm.makeNot(cond(u.getOperand, function))
+    case b: IASTBinaryExpression =>
+      val c1 = () => cond(b.getOperand1, function)
+      val c2 = () => cond(b.getOperand2, function)
+      val v1 = () => value(b.getOperand1, function)
+      val v2 = () => value(b.getOperand2, function)
+      b.getOperator match {
+        case BinaryOperator.LOGICAL_AND => fm.makeAnd(c1(), c2())
+        case BinaryOperator.LOGICAL_OR => fm.makeOr(c1(), c2())
+        case BinaryOperator.EQUALS => fm.makeEqual(v1(), v2())
+        case BinaryOperator.NOT_EQUALS => fm.makeNot(fm.makeEqual(v1(), v2()))
+        case BinaryOperator.LESS_THAN => fm.makeLt(v1(), v2())
+        case BinaryOperator.LESS_EQUAL => fm.makeLeq(v1(), v2())
+        case BinaryOperator.GREATER_THAN => fm.makeGt(v1(), v2())
+        case BinaryOperator.GREATER_EQUAL => fm.makeGeq(v1(), v2())
+        case _ => nonZero(b, function)
+      }
+    case _ => nonZero(e, function)
+  }
+
+  private def nonZero(e: IASTRightHandSide, function: String): Formula = {
+    fm.makeNot(fm.makeEqual(value(e, function), fm.makeNumber(0)))
+  }
+
+  private def fm = FormulaHelpers.fm
+}
@@ -35,6 +35,17 @@ object ExpressionHelpers {
   val dummyFunctionExitNode = new CFAFunctionExitNode(0, "")
   val dummyFunctionDefNode = new FunctionDefinitionNode(0, "", null, dummyFunctionExitNode, new java.util.ArrayList[IASTParameterDeclaration](), new java.util.ArrayList[String]()) {}
 
+  // the name of a variable in the formulas: globals by name, locals prefixed with their function
+  // None for pointers and for names we cannot scope
+  def variableName(id: IASTIdExpression, function: String): Option[String] = {
+    if (id.getExpressionType.isInstanceOf[IASTPointerTypeSpecifier]) return None
+    id.getDeclaration match {
+      case d: IASTDeclaration if d.isGlobal => Some(id.getName)
+      case null => None
+      case _ => if (function == null) None else Some(function + "::" + id.getName)
+    }
+  }
+
   def getChangedVariables(stmt: IASTNode): Set[String] = {
     if (stmt.isInstanceOf[IASTDeclaration])
       return Set.empty + ((stmt.asInstanceOf[IASTDeclaration]).getName)
@@ -0,0 +1,73 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import java.io._
+import collection.mutable.ListBuffer
+import at.ac.ist.concurrency_swapper.structures.Structure
+
+// A fix recipe is the list of constraints that turned the original program into the correct one.
+// It is written with anchors instead of statement numbers, so it can be replayed on a new revision of the code.
+// One constraint per line, the fields are separated by tabs (anchor texts are normalized and contain no tabs):
+//   after <function> <occurrence> <statement> <function> <occurrence> <statement>
+//   atomic <function>
+// (recipes of older versions have no occurrences, those refer to the first occurrence)
+object FixRecipe {
+  def write(filename: String, constraints: List[Constraint[Structure]]) {
+    val lines = constraints.flatMap(StableConstraint.of(_)).map {
+      case StableAfter(first, second) => List("after", first.function, first.occurrence, first.text, second.function, second.occurrence, second.text).mkString("\t")
+      case StableAtomicSection(function) => "atomic\t" + function
+    }
+    Helpers.writeToFile(filename, lines.map(_ + "\n").mkString)
+  }
+
+  def read(filename: String): List[StableConstraint] = {
+    val in = new FileInputStream(filename)
+    val content = Helpers.readToString(in)
+    in.close()
+    val res = new ListBuffer[StableConstraint]
+    for (line <- content.split("\n"); if !line.trim.isEmpty) {
+      line.split("\t") match {
+        case Array("after", f1, o1, t1, f2, o2, t2) => res += StableAfter(Anchor(f1, t1, o1.toInt), Anchor(f2, t2, o2.toInt))
+        case Array("after", f1, t1, f2, t2) => res += StableAfter(Anchor(f1, t1), Anchor(f2, t2))
+        case Array("atomic", f) => res += StableAtomicSection(f)
+        case _ => throw new Exception("Malformed line in recipe " + filename + ": " + line)
+      }
+    }
+    res.result()
+  }
+
+  // applies as much of the recipe as still fits the program, returns the new order and the constraints that did not fit
+  def apply(so: StatementOrder, recipe: List[StableConstraint]): (StatementOrder, List[StableConstraint]) = {
+    var res = so
+    val unmatched = new ListBuffer[StableConstraint]
+    for (sc <- recipe) {
+      sc.resolve(res.getProgram) match {
+        case Some(c) =>
+          res.integrate(List(c)) match {
+            case List(next) => res = next
+            case _ => unmatched += sc
+          }
+        case None => unmatched += sc
+      }
+    }
+    (res, unmatched.result())
+  }
+}
@@ -19,8 +19,7 @@ You should have received a copy of the GNU General Public License
 
 package at.ac.ist.concurrency_swapper.helpers
 
-import ac.at.ist.concurrency_swapper.z3formulas.Z3Formula
-import ac.at.ist.concurrency_swapper.z3formulas.Z3FormulaManager
+import ac.at.ist.concurrency_swapper.z3formulas.{Symbols, VarSet, Z3Formula, Z3FormulaManager}
 import org.sosy_lab.cpachecker.util.predicates.interfaces.Formula
 import org.sosy_lab.cpachecker.util.predicates.interfaces.FormulaManager
 import org.sosy_lab.cpachecker.cfa.ast.{ExpressionVisitor, IASTExpression}
@@ -28,16 +27,15 @@ import org.sosy_lab.cpachecker.util.predicates.SSAMap
 import org.sosy_lab.cpachecker.exceptions.UnrecognizedCCodeException
 
 object FormulaHelpers {
-  def Init(newFm: Z3FormulaManager) {
-    fm = newFm
+  def Init(newFm: Z3FormulaManager, thisThreadOnly: Boolean = false) {
+    fmVar.set(newFm, thisThreadOnly)
   }
 
   def getBounds(vars: Set[String]): Map[String, (Int, Int)] = {
     var map: Map[String, (Int, Int)] = Map.empty
     for (v <- vars) {
-      val vs: Array[String] = v.split("@")
-      val variable: String = vs(0)
-      val number: Int = Integer.parseInt(vs(1))
+      val variable: String = filterVar(v)
+      val number: Int = filterIndexInt(v)
       if (!map.contains(variable)) {
         map += variable -> (number, number)
       }
@@ -72,21 +70,17 @@ object FormulaHelpers {
   }
 
   def getVarsOfLevel(variables: Set[String], level: Int): Set[String] = {
-    var res: Set[String] = Set.empty
-    for (`var` <- variables) {
-      if (`var`.endsWith("@" + Integer.toString(level))) res += `var`
-    }
-    return res
+    return variables.filter(filterIndexInt(_) == level)
   }
 
-  final val filterVar = (s:String) => s.split("@")(0)
-  final val filterIndex = (s:String) => s.split("@")(1)
-  final val filterIndexInt = (s:String) => s.split("@")(1).toInt
+  // the strings are parsed once by the symbol table, the formula code itself works on packed variables
+  final val filterVar = (s:String) => Symbols.name(Symbols.nameId(Symbols.parse(s)))
+  final val filterIndex = (s:String) => Integer.toString(Symbols.index(Symbols.parse(s)))
+  final val filterIndexInt = (s:String) => Symbols.index(Symbols.parse(s))
 
   def shiftVariables(f: Formula, shift: Int) : Formula = {
-    val min = fm.extractVariablesS(f).map(filterIndexInt).min
-    val max = fm.extractVariablesS(f).map(filterIndexInt).max
-    shiftVariables(new StateFormula(f, min, max), shift)
+    val vars = fm.extractVariablesP(f)
+    shiftVariables(new StateFormula(f, vars.minIndex, vars.maxIndex), shift)
   }
 
   def shiftVariables(f: StateFormula, shift: Int) : Formula = {
@@ -96,31 +90,23 @@ object FormulaHelpers {
   /// This moves variables indexes by shift amount
   /// if variables is empty it moves them all
   def shiftVariables(f: StateFormula, shift: Int, variables: Set[String]): Formula = {
-    var i: Int = if (shift >=0) f.getUpperBound else f.getLowerBound
-    var newf2: Formula = f.getFormula
-    while (if (shift >= 0) i >= f.getLowerBound else i <= f.getUpperBound) {
-      val vars: Set[String] = fm.extractVariablesS(newf2).filter(s => if (variables.isEmpty) true else variables.contains(s.split("@")(0)))
-      for (variable <- FormulaHelpers.getVarsOfLevel(vars, i)) {
-        val newvar: String = variable.replace("@" + Integer.toString(i), "@" + Integer.toString(i + shift))
-        newf2 = FormulaHelpers.replaceVar(newf2, variable, newvar)
-      }
-      i -= (if (shift >= 0) 1 else -1)
+    if (shift == 0) return f.getFormula
+    val names = variables.map(Symbols.id)
+    // the levels are renamed simultaneously, so they cannot run into each other
+    var mapping: Map[Long, Long] = Map.empty
+    for (v <- fm.extractVariablesP(f.getFormula)) {
+      val i = Symbols.index(v)
+      if (i >= f.getLowerBound && i <= f.getUpperBound && (names.isEmpty || names.contains(Symbols.nameId(v))))
+        mapping += v -> Symbols.withIndex(v, i + shift)
     }
-    newf2
+    fm.rename(f.getFormula, mapping)
   }
 
   def moveLastAssignment(f: Formula, lastNum: Int) : Formula = {
-    var newf = f
-    val vars = fm.extractAssignedVariables(f).map(filterVar)
-    for (v <- vars)
-    {
-      val max = fm.extractAssignedVariables(f).filter(_.split("@")(0) == v).map(filterIndexInt).max
-      if (max < lastNum)
-      {
-        newf = FormulaHelpers.replaceVar(newf, v + "@" + max, v + "@" + lastNum)
-      }
-    }
-    newf
+    var mapping: Map[Long, Long] = Map.empty
+    for (v <- fm.extractAssignedVariablesP(f).highest; if Symbols.index(v) < lastNum)
+      mapping += v -> Symbols.withIndex(v, lastNum)
+    fm.rename(f, mapping)
   }
 
   // the purpose of this is to move the first use of a variable in f2 to the last assignment in f1
@@ -128,25 +114,18 @@ object FormulaHelpers {
   // we assume that f1 and f2 do not overlap (previous shift)
   // we return the second formula as it is adjusted
   def stichFormulas(f1: Formula, f2: Formula): Formula = {
-    var f2p = f2
-    val vassf1: Set[String] = fm.extractAssignedVariables(f1)
-    val varsf1 = vassf1.map(filterVar)
-    for (v <- fm.extractUsedVariables(f2)) {
-      val vname = filterVar(v)
-      // check if vname is assigned in f1
-      if (varsf1.contains(vname))
-      {
-        // calculate maximum and rename
-        val max = vassf1.filter(_.split("@")(0) == vname).map(filterIndexInt).max
-        f2p = fm.replace(f2p, v, vname + "@" + max)
-      }
-      else
-      {
-        // we set it to 0
-        f2p = fm.replace(f2p, v, vname + "@0")
-      }
+    // the last assignment of every variable in f1
+    var last: Map[Int, Int] = Map.empty
+    for (v <- fm.extractAssignedVariablesP(f1).highest)
+      last += Symbols.nameId(v) -> Symbols.index(v)
+    var mapping: Map[Long, Long] = Map.empty
+    for (v <- fm.extractUsedVariablesP(f2)) {
+      // if the variable is assigned in f1 we read the maximum, otherwise we set it to 0
+      val newvar = Symbols.withIndex(v, last.getOrElse(Symbols.nameId(v), 0))
+      if (newvar != v)
+        mapping += v -> newvar
     }
-    return f2p
+    return fm.rename(f2, mapping)
   }
 
 
@@ -156,20 +135,22 @@ object FormulaHelpers {
     vars.map(filterIndexInt).max
   }
 
+  def getHighestIndex(vars: VarSet): Int = {
+    if (vars.isEmpty) return 1
+    vars.maxIndex
+  }
+
   // we get the highest index of these variables
   // however, if the highest is 0 then not included
   def getHighestVars(vars: Set[String]): Set[String] = {
-    var res : Set[String] = Set.empty
-    val varnames = vars.map(filterVar)
-    for (v <- varnames)
-    {
-      val max = vars.filter(_.split("@")(0) == v).map(filterIndexInt).max
-      res += v + "@" + max
-    }
-    return res
+    return VarSet.fromNames(vars).highest.toNames
   }
 
   def getFormula(expr : IASTExpression, functionName:String): Formula = {
+    DirectEncoder.condition(expr, functionName) match {
+      case Some(f) => return f
+      case None =>
+    }
     // get private class from CPAChecker
     //val constraints: CtoFormulaConverter#Constraints = new CtoFormulaConverter#Constraints
     val ConstraintsCl = Class.forName("org.sosy_lab.cpachecker.util.predicates.CtoFormulaConverter$Constraints")
@@ -188,10 +169,11 @@ object FormulaHelpers {
 
     // finally use that class to get our formula
     var formula = expr.accept(v)
-    val min = fm.extractVariablesS(formula).map(FormulaHelpers.filterIndexInt).min
+    val min = fm.extractVariablesP(formula).minIndex
     formula = FormulaHelpers.shiftVariables(new StateFormula(formula, 0, 3), -min, Set.empty)
     return formula
   }
 
-  private[concurrency_swapper] var fm: Z3FormulaManager = null
+  private val fmVar = new PerThread[Z3FormulaManager]
+  private[concurrency_swapper] def fm = fmVar.get
 }
\ No newline at end of file
@@ -19,7 +19,7 @@ You should have received a copy of the GNU General Public License
 
 package at.ac.ist.concurrency_swapper.helpers
 
-import ac.at.ist.concurrency_swapper.z3formulas.Z3FormulaManager
+import ac.at.ist.concurrency_swapper.z3formulas.{SerializedFormula, Z3FormulaManager}
 import org.sosy_lab.cpachecker.cfa.objectmodel.CFAEdge
 import org.sosy_lab.cpachecker.util.predicates.interfaces.Formula
 import org.sosy_lab.cpachecker.util.predicates.interfaces.FormulaManager
@@ -28,8 +28,8 @@ import org.sosy_lab.cpachecker.exceptions.UnrecognizedCCodeException
 import org.sosy_lab.cpachecker.util.predicates.SSAMap
 
 object GatedCommand {
-  def Init(newFm: Z3FormulaManager) {
-    fm = newFm
+  def Init(newFm: Z3FormulaManager, thisThreadOnly: Boolean = false) {
+    fmVar.set(newFm, thisThreadOnly)
   }
 
   def ConvertEdge(edge: CFAEdge): GatedCommand = {
@@ -47,15 +47,14 @@ object GatedCommand {
     if (phip.isTrue) return fm.makeTrue
     else
     {
-      if (fm.extractVariablesS(phip).isEmpty)
+      if (fm.extractVariablesP(phip).isEmpty)
         return fm.makeImplies(tau.getFormula, phip)
-      val max = fm.extractVariablesS(phip).map(FormulaHelpers.filterIndexInt).max
-      var newphi = FormulaHelpers.shiftVariables(phip, tau.getUpperBound - max)
+      val max = fm.extractVariablesP(phip).maxIndex
+      val newphi = FormulaHelpers.shiftVariables(phip, tau.getUpperBound - max)
       val newphip = FormulaHelpers.stichFormulas(tau.getFormula, newphi)
-      newphi = fm.makeImplies(tau.getFormula, newphip)
-      val varsToQuantify = FormulaHelpers.getVarsOfLevel(fm.extractVariablesS(newphi), tau.getUpperBound)
-      newphi = fm.makeForall(newphi, varsToQuantify)
-      newphi
+      val varsToQuantify = (fm.extractVariablesP(tau.getFormula) ++ fm.extractVariablesP(newphip)).ofLevel(tau.getUpperBound)
+      // assigned values are substituted, only what tau leaves open is quantified
+      fm.makeForallImpliesEliminating(tau.getFormula, newphip, varsToQuantify)
     }
   }
 
@@ -65,7 +64,19 @@ object GatedCommand {
     return (f1, f2)
   }
 
-  private var fm: Z3FormulaManager = null
+  // a gated command kept independently of the z3 context it was built in
+  class Stored(val gate: SerializedFormula, val stmt: SerializedFormula, val upperBound: Int)
+
+  def store(c: GatedCommand): Stored = {
+    return new Stored(fm.serialize(c.getGate), fm.serialize(c.getStmt.getFormula), c.getStmt.getUpperBound)
+  }
+
+  def load(s: Stored): GatedCommand = {
+    return new GatedCommand(fm.deserialize(s.gate), new StateFormula(fm.deserialize(s.stmt), 0, s.upperBound))
+  }
+
+  private val fmVar = new PerThread[Z3FormulaManager]
+  private def fm = fmVar.get
 }
 
 class GatedCommand {
@@ -0,0 +1,93 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import java.util.concurrent.atomic.AtomicInteger
+import org.sosy_lab.cpachecker.cfa.ast._
+import org.sosy_lab.cpachecker.cfa.objectmodel.CFAEdgeType
+import org.sosy_lab.cpachecker.cfa.objectmodel.c.AssumeEdge
+import at.ac.ist.concurrency_swapper.structures.{FunctionCallStatement, Statement}
+import at.ac.ist.concurrency_swapper.translation.{AtomicStart, AtomicEnd, Assert, PointerInit, PointerDeref, Up, Down}
+
+// Answers mover queries for statements that touch disjoint variables without asking z3: if neither side writes a
+// variable the other one reads or writes, both orders have the same gate and the same effect.
+// The variable analysis of the translation is only exact for simple statements (no pointers, no calls, no
+// unary operators), for everything else we return None and the query goes to z3.
+object Independence {
+  val queries = new AtomicInteger(0) // how often we were asked
+  val hits = new AtomicInteger(0) // how often we could answer without z3
+
+  def reset() {
+    queries.set(0)
+    hits.set(0)
+  }
+
+  private def simple(e: IASTRightHandSide): Boolean = e match {
+    case id: IASTIdExpression => !id.getExpressionType.isInstanceOf[IASTPointerTypeSpecifier]
+    case _: IASTIntegerLiteralExpression => true
+    case b: IASTBinaryExpression => simple(b.getOperand1) && simple(b.getOperand2)
+    case _ => false
+  }
+
+  private def vars(v: VariableAnalysisResult): Option[Set[String]] = v match {
+    case SomeVars(s) => Some(s)
+    case _ => None // declarations (or null if the analysis did not understand the statement)
+  }
+
+  // the variables the statement reads and writes, if we know them exactly
+  private def accesses(s: Statement): Option[(Set[String], Set[String])] = {
+    if (s.isInstanceOf[FunctionCallStatement]) return None
+    val edge = s.getEdge
+    if (PointerDeref.accepts(edge) || PointerInit.accepts(edge)) return None
+    if (AtomicStart.accepts(edge) || AtomicEnd.accepts(edge)) return Some((Set.empty, Set.empty))
+    if (Down.accepts(edge) || Up.accepts(edge)) {
+      // lock waits until the lock is free, so it also reads what it changes
+      return vars(s.getChangedVariables()).map(l => (l, l))
+    }
+    if (edge.getEdgeType == CFAEdgeType.AssumeEdge) {
+      val e: IASTRightHandSide = edge.asInstanceOf[AssumeEdge].getExpression
+      if (!simple(e)) return None
+      return Some((ExpressionHelpers.getUsedVariables(e), Set.empty))
+    }
+    import scala.collection.JavaConversions._
+    edge.getRawAST match {
+      case a: IASTExpressionAssignmentStatement if simple(a.getLeftHandSide) && simple(a.getRightHandSide) =>
+      case c: IASTFunctionCallStatement if Assert.accepts(edge) || ExpressionHelpers.getFunctionDef(edge).map(_._1) == Some("assume") =>
+        if (!c.getFunctionCallExpression.getParameterExpressions.forall(simple(_))) return None
+      case _ => return None
+    }
+    for (used <- vars(s.getUsedVariables()); changed <- vars(s.getChangedVariables())) yield (used, changed)
+  }
+
+  // Some(true) if the two statement lists are independent, None if we cannot tell without z3
+  def independent(stmt1: List[Statement], stmt2: List[Statement]): Option[Boolean] = {
+    queries.incrementAndGet
+    val a1 = stmt1.map(accesses)
+    val a2 = stmt2.map(accesses)
+    if (a1.contains(None) || a2.contains(None)) return None
+    val (r1, w1) = a1.flatten.foldLeft((Set.empty[String], Set.empty[String]))((x, y) => (x._1 ++ y._1, x._2 ++ y._2))
+    val (r2, w2) = a2.flatten.foldLeft((Set.empty[String], Set.empty[String]))((x, y) => (x._1 ++ y._1, x._2 ++ y._2))
+    if ((w1 & (r2 ++ w2)).isEmpty && (w2 & r1).isEmpty) {
+      hits.incrementAndGet
+      return Some(true)
+    }
+    None
+  }
+}
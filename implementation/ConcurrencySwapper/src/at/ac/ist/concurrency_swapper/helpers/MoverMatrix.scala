@@ -0,0 +1,65 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import java.util.concurrent.{TimeUnit, Executors}
+import java.util.concurrent.atomic.AtomicInteger
+import at.ac.ist.concurrency_swapper.structures.Statement
+
+// Computes the mover relation for all pairs of statements of different threads before the search starts, so that
+// the counterexample analysis finds it in ParallelAnalysis.Movers. The pairs are split among worker threads,
+// each of them works on its own z3 context (set up by initWorker and freed with ParallelAnalysis.ReleaseThread).
+object MoverMatrix {
+  def compute(so: StatementOrder, workers: Int, initWorker: () => Unit) {
+    // the statements are grouped by the line they are printed on as this is how the counterexamples refer to them
+    val lines = so.printProgram(PrintType.Poirot)._2.values.map(_.map(_._2)).toArray
+    // statements of helper functions belong to no thread, they may run in parallel to anything
+    val threads = so.getProgram.getThreadNames
+    def thread(l: List[Statement]) = l(0).getThreadName()
+    def parallel(a: List[Statement], b: List[Statement]) =
+      !threads.contains(thread(a)) || !threads.contains(thread(b)) || thread(a) != thread(b)
+    // one query answers both directions of both statements, so every unordered pair is enough
+    val pairs = for (i <- lines.indices; j <- 0 until i; if parallel(lines(i), lines(j))) yield (lines(i), lines(j))
+    println("Precomputing movers for " + pairs.length + " statement pairs on " + workers + " threads")
+
+    val next = new AtomicInteger(0)
+    val failed = new AtomicInteger(0)
+    val pool = Executors.newFixedThreadPool(workers)
+    for (w <- 0 until workers)
+      pool.execute(new Runnable {
+        def run() {
+          initWorker()
+          try {
+            var i = next.getAndIncrement
+            while (i < pairs.length) {
+              // a failed query is simply left to the lazy computation of the main thread
+              try ParallelAnalysis.IsRightMover(pairs(i)._1, pairs(i)._2, null)
+              catch { case e: Exception => failed.incrementAndGet }
+              i = next.getAndIncrement
+            }
+          } finally ParallelAnalysis.ReleaseThread()
+        }
+      })
+    pool.shutdown()
+    pool.awaitTermination(Long.MaxValue, TimeUnit.SECONDS)
+    if (failed.get > 0)
+      println(failed.get + " mover queries failed during precomputation")
+  }
+}
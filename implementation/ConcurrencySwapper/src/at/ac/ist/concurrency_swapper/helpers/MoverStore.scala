@@ -0,0 +1,103 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import collection.mutable
+import at.ac.ist.concurrency_swapper.structures.Statement
+
+// The mover relation between statement groups (the statement lists of counterexample lines, usually just one
+// statement). Every group gets a dense id, the row of a group holds for every 64 columns four words of bits:
+// right known, right value, left known, left value. Looking up a single statement allocates nothing.
+class MoverStore {
+  private var singleIds = new Array[Int](1024) // statement number -> group id + 1 (0 means no id yet)
+  private val listIds = new mutable.HashMap[List[Int], Int] // groups of more than one statement
+  private var rows = new Array[Array[Long]](64)
+  private var groups = 0
+
+  val Unknown = -1
+
+  def group(stmts: List[Statement]): Int = synchronized {
+    if (stmts.tail.isEmpty) {
+      val n = stmts.head.getNumber
+      if (n >= singleIds.length)
+        singleIds = java.util.Arrays.copyOf(singleIds, math.max(n + 1, singleIds.length * 2))
+      if (singleIds(n) == 0)
+        singleIds(n) = newGroup() + 1
+      singleIds(n) - 1
+    } else
+      listIds.getOrElseUpdate(stmts.map(_.getNumber), newGroup())
+  }
+
+  private def newGroup(): Int = {
+    if (groups == rows.length)
+      rows = java.util.Arrays.copyOf(rows, rows.length * 2)
+    rows(groups) = new Array[Long](0)
+    groups += 1
+    groups - 1
+  }
+
+  // 1 if g1 is a (right or left) mover over g2, 0 if not and Unknown if we have not checked yet
+  def get(g1: Int, g2: Int, right: Boolean): Int = synchronized {
+    val row = rows(g1)
+    val i = 4 * (g2 >> 6) + (if (right) 0 else 2)
+    if (i >= row.length) return Unknown
+    val bit = 1L << (g2 & 63)
+    if ((row(i) & bit) == 0) Unknown
+    else if ((row(i + 1) & bit) != 0) 1
+    else 0
+  }
+
+  // the groups of a whole sequence of statement lists, under one lock
+  def groups(stmts: Seq[List[Statement]]): Array[Int] = synchronized {
+    stmts.map(group).toArray
+  }
+
+  // get for all of others at once: the row of g1 is read once and under one lock
+  def getAll(g1: Int, others: Array[Int], right: Boolean): Array[Int] = synchronized {
+    val row = rows(g1)
+    val offset = if (right) 0 else 2
+    val res = new Array[Int](others.length)
+    var j = 0
+    while (j < others.length) {
+      val i = 4 * (others(j) >> 6) + offset
+      val bit = 1L << (others(j) & 63)
+      res(j) = if (i >= row.length || (row(i) & bit) == 0) Unknown else if ((row(i + 1) & bit) != 0) 1 else 0
+      j += 1
+    }
+    res
+  }
+
+  def put(g1: Int, g2: Int, right: Boolean, value: Boolean) = synchronized {
+    val i = 4 * (g2 >> 6) + (if (right) 0 else 2)
+    if (i >= rows(g1).length)
+      rows(g1) = java.util.Arrays.copyOf(rows(g1), 4 * ((groups + 63) >> 6))
+    val row = rows(g1)
+    val bit = 1L << (g2 & 63)
+    row(i) |= bit
+    if (value) row(i + 1) |= bit else row(i + 1) &= ~bit
+  }
+
+  def clear() = synchronized {
+    java.util.Arrays.fill(singleIds, 0)
+    listIds.clear()
+    rows = new Array[Array[Long]](64)
+    groups = 0
+  }
+}
@@ -27,7 +27,7 @@ import org.sosy_lab.cpachecker.cfa.objectmodel.CFANode
 import org.sosy_lab.cpachecker.util.predicates.interfaces.Formula
 import org.sosy_lab.cpachecker.util.predicates.interfaces.FormulaManager
 import org.sosy_lab.cpachecker.util.predicates.interfaces.TheoremProver
-import ac.at.ist.concurrency_swapper.z3formulas.{Z3Helper, Z3TheoremProver, Z3FormulaManager}
+import ac.at.ist.concurrency_swapper.z3formulas.{Z3Helper, Z3ModelWrapper, Z3TheoremProver, Z3FormulaManager}
 import scala.Some
 import at.ac.ist.concurrency_swapper.translation.TranslationChain
 import at.ac.ist.concurrency_swapper.structures.Statement
@@ -106,15 +106,77 @@ object ParallelAnalysis {
     return true
   }
 
-  def Init(fm1: Z3FormulaManager, prover1: Z3TheoremProver) {
-    fm = fm1
-    prover = prover1
-    z3 = fm1.getZ3()
+  def Init(fm1: Z3FormulaManager, prover1: Z3TheoremProver, thisThreadOnly: Boolean = false) {
+    sessions.set(new Session(fm1, prover1), thisThreadOnly)
   }
 
-  private var fm: Z3FormulaManager = null
-  private var prover: Z3TheoremProver = null
-  private var z3: Z3Context = null
+  // frees the context of a thread that was initialized with thisThreadOnly
+  def ReleaseThread() {
+    val s = sessions.get
+    s.prover.delete()
+    s.z3.delete()
+    sessions.clearLocal()
+  }
+
+  // everything a mover check needs from z3, the precomputation workers each have their own
+  private class Session(val fm: Z3FormulaManager, var prover: Z3TheoremProver) {
+    var z3: Z3Context = fm.getZ3()
+    var queriesSinceRecycle = 0
+  }
+  private val sessions = new PerThread[Session]
+  private def fm = sessions.get.fm
+  private def prover = sessions.get.prover
+
+  // the context and the solver live across mover checks, every query runs in its own push/pop scope. As Z3 still
+  // keeps the terms of old queries around we recycle the context after a number of queries, when the process uses
+  // too much memory or when a query left a scope open (e.g. because of an exception)
+  var recycleAfterQueries = 2000
+  var recycleAboveMB = 1024
+  private val memoryCheckInterval = 50
+
+  // With a reduced width > 0 pairs are first translated and checked with machine integers of that many bits, which
+  // z3 bit-blasts much faster. Such a check alone proves nothing about 32 bit integers, but its counter models are
+  // learned by ConcreteExecution and replayed at 32 bit. Only the refutations confirmed that way are used, every
+  // other pair is checked at 32 bit. The answers go to the same store and persistent cache.
+  var reducedWidth = 0
+  val reducedWidthRefutations = new java.util.concurrent.atomic.AtomicInteger(0)
+
+  // memory of the process (including Z3, which the JVM heap does not show) in MB, -1 if we cannot find out. Linux has
+  // the resident size in /proc, elsewhere (Windows) we ask the HotSpot bean for the committed memory of the process
+  private def residentMB(): Long = {
+    val status = new File("/proc/self/status")
+    if (!status.exists()) {
+      java.lang.management.ManagementFactory.getOperatingSystemMXBean match {
+        case os: com.sun.management.OperatingSystemMXBean => return os.getCommittedVirtualMemorySize / (1024 * 1024)
+        case _ => return -1
+      }
+    }
+    val in = new FileInputStream(status)
+    val content = try Helpers.readToString(in) finally in.close()
+    content.split("\n").find(_.startsWith("VmRSS:")) match {
+      case Some(line) => line.split("\\s+")(1).toLong / 1024
+      case None => -1
+    }
+  }
+
+  private def recycleZ3(s: Session) {
+    s.prover.delete()
+    s.z3.delete()
+    s.z3 = new Z3Context(Z3Helper.getEmptyConfig)
+    s.fm.setZ3(s.z3)
+    s.prover = new Z3TheoremProver(s.z3)
+    s.prover.init
+    s.queriesSinceRecycle = 0
+  }
+
+  private def recycleZ3IfNeeded() {
+    val s = sessions.get
+    s.queriesSinceRecycle += 1
+    if (s.queriesSinceRecycle >= recycleAfterQueries || s.prover.scopeDepth != 0)
+      recycleZ3(s)
+    else if (s.queriesSinceRecycle % memoryCheckInterval == 0 && residentMB() > recycleAboveMB)
+      recycleZ3(s)
+  }
 
   // gatedcommand, name of the command (unique number), printed command string
   def SequentialComposition(cs1:(GatedCommand,String, String), cs2: (GatedCommand,String, String)) : (GatedCommand, String) = {
@@ -181,8 +243,9 @@ object ParallelAnalysis {
       for (beta <- edges2) {
         val alphabeta = SequentialComposition(alpha, beta)
         val betaalpha = SequentialComposition(beta, alpha)
-        if (!TestSimulation(alphabeta, betaalpha, formulaLog)) rightBlocker += beta._2
-        if (!TestSimulation(betaalpha, alphabeta, formulaLog)) leftBlocker += beta._2
+        val (right, left) = TestSimulationBoth(alphabeta, betaalpha, true, true, formulaLog)
+        if (right.get != Some(true)) rightBlocker += beta._2
+        if (left.get != Some(true)) leftBlocker += beta._2
       }
       var mover = "N"
       if (leftBlocker.isEmpty && rightBlocker.isEmpty) mover = "LR"
@@ -195,108 +258,199 @@ object ParallelAnalysis {
     }
   }
 
-  var MoverCache = new mutable.HashMap[(List[Int],List[Int],Boolean),Boolean]()
+  val Movers = new MoverStore
 
   // check if it is a right or leftmover (for leftmover check set right to false)
   private def IsMover(stmt1: List[Statement], stmt2: List[Statement], right: Boolean, out: BufferedWriter):Boolean = {
-    MoverCache.get(stmt1.map(_.getNumber),stmt2.map(_.getNumber),right) match {
-      case Some(x) => return x
-      case None =>
-        // we reset z3 as otherwise some scary things happen
-        z3.delete()
-        z3 = new Z3Context(Z3Helper.getEmptyConfig)
-        fm.setZ3(z3)
-        prover = new Z3TheoremProver(z3)
-        prover.init
-
-        out.write("Org. Commands: (1) " + stmt1(0) + "\n")
-        out.write("Org. Commands: (2) " + stmt2(0) + "\n")
-        out.flush()
-
-        val stmt1p = stmt1.map(s => (TranslationChain.getFormula(s),TranslationChain.printEdge(s)))
-        val stmt2p = stmt2.map(s => (TranslationChain.getFormula(s),TranslationChain.printEdge(s)))
-        // combine all the commands
-        val stmt1c = stmt1p.tail.foldLeft(stmt1p.head)(SequentialComposition)
-        val stmt2c = stmt2p.tail.foldLeft(stmt2p.head)(SequentialComposition)
-        out.write("Commands: (1) " + stmt1c._2 + "\t" + stmt1c._1 + "\n")
-        out.write("Commands: (2) " + stmt2c._2 + "\t" + stmt2c._1 + "\n")
-        val cs12 = SequentialComposition(stmt1c, stmt2c)
-        val cs21 = SequentialComposition(stmt2c, stmt1c)
-        val res = if (right)
-          TestSimulation(cs12, cs21, out)
-        else
-          TestSimulation(cs21, cs12, out)
+    val g1 = Movers.group(stmt1)
+    val g2 = Movers.group(stmt2)
+    val known = Movers.get(g1, g2, right)
+    if (known != Movers.Unknown) return known == 1
+    // stmt1 right mover over stmt2 is the same query as stmt2 left mover over stmt1, so one pair fills four entries
+    val (r, l) = ComputePair(stmt1, stmt2, out)
+    // an answer z3 could not give in time is not stored, it counts as no mover for this query only
+    for (b <- r) {
+      Movers.put(g1, g2, true, b)
+      Movers.put(g2, g1, false, b)
+    }
+    for (b <- l) {
+      Movers.put(g1, g2, false, b)
+      Movers.put(g2, g1, true, b)
+    }
+    (if (right) r else l).getOrElse(false)
+  }
 
-        MoverCache += (stmt1.map(_.getNumber),stmt2.map(_.getNumber),right) -> res
+  // returns if stmt1 is a right mover and if it is a left mover over stmt2 (None if the solver did not decide it)
+  private def ComputePair(stmt1: List[Statement], stmt2: List[Statement], out: BufferedWriter):(Option[Boolean], Option[Boolean]) = {
+    // statements on disjoint variables commute, there is no need to ask z3
+    if (Independence.independent(stmt1, stmt2) == Some(true))
+      return (Some(true), Some(true))
+    // a concrete state on which the two orders differ shows that it is no mover
+    val rightRefuted = ConcreteExecution.refutes(stmt1 ++ stmt2, stmt2 ++ stmt1)
+    val leftRefuted = ConcreteExecution.refutes(stmt2 ++ stmt1, stmt1 ++ stmt2)
+    var right : Option[Boolean] = if (rightRefuted == Some(true)) Some(false) else None
+    var left : Option[Boolean] = if (leftRefuted == Some(true)) Some(false) else None
+    if (right.isDefined && left.isDefined)
+      return (right, left)
+    recycleZ3IfNeeded()
 
-        res
+    if (out != null) {
+      out.write("Org. Commands: (1) " + stmt1(0) + "\n")
+      out.write("Org. Commands: (2) " + stmt2(0) + "\n")
+      out.flush()
     }
+
+    val stmt1p = stmt1.map(s => (TranslationChain.getFormula(s),TranslationChain.printEdge(s)))
+    val stmt2p = stmt2.map(s => (TranslationChain.getFormula(s),TranslationChain.printEdge(s)))
+    // earlier runs stored their results under the formulas (statement numbers change from run to run)
+    val texts1 = stmt1p.map(c => exactText(c._1))
+    val texts2 = stmt2p.map(c => exactText(c._1))
+    val rightKey = PersistentMoverCache.key(texts1, texts2, fm.intWidth, true)
+    val leftKey = PersistentMoverCache.key(texts1, texts2, fm.intWidth, false)
+    if (right.isEmpty) right = PersistentMoverCache.get(rightKey)
+    if (left.isEmpty) left = PersistentMoverCache.get(leftKey)
+    if (right.isDefined && left.isDefined)
+      return (right, left)
+
+    // a cheap try at a smaller width, but only if the statements can be replayed concretely
+    if (reducedWidth > 0 && reducedWidth < fm.intWidth && rightRefuted.isDefined) {
+      val (r, l) = ReducedWidthRefutes(stmt1, stmt2, right.isEmpty, left.isEmpty)
+      if (r) {
+        right = Some(false)
+        PersistentMoverCache.put(rightKey, false)
+      }
+      if (l) {
+        left = Some(false)
+        PersistentMoverCache.put(leftKey, false)
+      }
+      if (right.isDefined && left.isDefined)
+        return (right, left)
+    }
+
+    // the composed commands of both groups are summarized once and reused for every other group
+    val stmt1c = (TranslationChain.getSummary(stmt1), stmt1p.map(_._2).mkString("; "))
+    val stmt2c = (TranslationChain.getSummary(stmt2), stmt2p.map(_._2).mkString("; "))
+    if (out != null) {
+      out.write("Commands: (1) " + stmt1c._2 + "\t" + stmt1c._1 + "\n")
+      out.write("Commands: (2) " + stmt2c._2 + "\t" + stmt2c._1 + "\n")
+    }
+    val cs12 = SequentialComposition(stmt1c, stmt2c)
+    val cs21 = SequentialComposition(stmt2c, stmt1c)
+    // counter models are only worth learning if the statements can be run concretely
+    val (r, l) = TestSimulationBoth(cs12, cs21, right.isEmpty, left.isEmpty, out, rightRefuted.isDefined)
+    if (right.isEmpty) {
+      right = r.get
+      for (b <- right) PersistentMoverCache.put(rightKey, b)
+    }
+    if (left.isEmpty) {
+      left = l.get
+      for (b <- left) PersistentMoverCache.put(leftKey, b)
+    }
+    (right, left)
+  }
+
+  // the command as z3 prints it, unlike toString this keeps every operator
+  private def exactText(c: GatedCommand): PersistentMoverCache.CommandText = {
+    val gate = fm.serialize(c.getGate)
+    val stmt = fm.serialize(c.getStmt.getFormula)
+    PersistentMoverCache.CommandText(gate.smt + "\n" + stmt.smt + "\n" + c.getStmt.getUpperBound,
+      List(stmt.assignedVariables, stmt.usedVariables))
+  }
+
+  // true for the directions in which the check at reducedWidth failed and ConcreteExecution could replay the
+  // counter model at 32 bit
+  private def ReducedWidthRefutes(stmt1: List[Statement], stmt2: List[Statement], forward: Boolean, backward: Boolean):(Boolean, Boolean) = {
+    val fullWidth = fm.intWidth
+    fm.intWidth = reducedWidth
+    val (r, l) = try {
+      val stmt1c = (TranslationChain.getSummary(stmt1), "")
+      val stmt2c = (TranslationChain.getSummary(stmt2), "")
+      TestSimulationBoth(SequentialComposition(stmt1c, stmt2c), SequentialComposition(stmt2c, stmt1c), forward, backward, null, true)
+    } finally {
+      fm.intWidth = fullWidth
+    }
+    val right = r == Some(Some(false)) && ConcreteExecution.refutes(stmt1 ++ stmt2, stmt2 ++ stmt1) == Some(true)
+    val left = l == Some(Some(false)) && ConcreteExecution.refutes(stmt2 ++ stmt1, stmt1 ++ stmt2) == Some(true)
+    if (right) reducedWidthRefutations.incrementAndGet
+    if (left) reducedWidthRefutations.incrementAndGet
+    (right, left)
   }
 
   def IsRightMover(stmt1: List[Statement], stmt2: List[Statement], out: BufferedWriter) = IsMover(stmt1,stmt2, true, out)
 
   def IsLeftMover(stmt1: List[Statement], stmt2: List[Statement], out: BufferedWriter) = IsMover(stmt1,stmt2, false, out)
 
-  def TestSimulation(cs12:(GatedCommand,String), cs21: (GatedCommand,String), out: BufferedWriter) : Boolean = {
+  // how many of the others stmt can move over one after the other before it hits one it is no mover over
+  // (the answers of the store are read in one go, only the unknown ones are computed)
+  def MoverPrefix(stmt: List[Statement], others: Seq[List[Statement]], right: Boolean, out: BufferedWriter): Int = {
+    val known = Movers.getAll(Movers.group(stmt), Movers.groups(others), right)
+    var i = 0
+    for (o <- others) {
+      val mover = if (known(i) != Movers.Unknown) known(i) == 1 else IsMover(stmt, o, right, out)
+      if (!mover) return i
+      i += 1
+    }
+    i
+  }
+
+  // the positions of the others stmt is no (right or left) mover over
+  def NonMovers(stmt: List[Statement], others: IndexedSeq[List[Statement]], right: Boolean, out: BufferedWriter): mutable.BitSet = {
+    val known = Movers.getAll(Movers.group(stmt), Movers.groups(others), right)
+    val res = new mutable.BitSet(others.length)
+    for (i <- 0 until others.length) {
+      if (known(i) == 0 || (known(i) == Movers.Unknown && !IsMover(stmt, others(i), right, out)))
+        res += i
+    }
+    res
+  }
+
+  // Checks in one solver scope if cs12 is simulated by cs21 (forward) and the other way round (backward), as far as
+  // asked for (see Z3TheoremProver.areValid). A direction that was asked for is Some(answer), the answer is None if
+  // the solver decided neither that it holds nor that it fails. With learn the initial states of the counter models
+  // of the failing checks are handed to ConcreteExecution.
+  def TestSimulationBoth(cs12:(GatedCommand,String), cs21: (GatedCommand,String), forward: Boolean, backward: Boolean,
+                         out: BufferedWriter, learn: Boolean = false) : (Option[Option[Boolean]], Option[Option[Boolean]]) = {
     val (c12, s12) = cs12
     val (c21, s21) = cs21
-    out.flush() // let's save the file in case we crash
-    var (f1, f2) = GatedCommand.Simulates(c12, c21)
-    f1 = fm.makeValid(f1)
-    f2 = fm.makeValid(f2)
-    val f1p = fm.simplify(f1)
-    val f2p = fm.simplify(f2)
-    prover.push(f1p)
-    val sat1: Option[Boolean] = prover.checkSat()
-    prover.pop
-    prover.push(f2p)
-    val sat2: Option[Boolean] = prover.checkSat()
-    val model = prover.getZ3Model
-    prover.pop
+    if (out != null) out.flush() // let's save the file in case we crash
+    val raw = new mutable.ListBuffer[Formula]
+    if (forward) {
+      val (f1, f2) = GatedCommand.Simulates(c12, c21)
+      raw += f1
+      raw += f2
+    }
+    if (backward) {
+      val (f1, f2) = GatedCommand.Simulates(c21, c12)
+      raw += f1
+      raw += f2
+    }
+    val checks = raw.map(f => fm.simplify(f))
+    val counterModel = if (learn) (i: Int, model: Z3ModelWrapper) => LearnCounterModel(checks(i), model) else null
+    val valid = prover.areValid(checks, counterModel)
     if (out != null) {
       out.write("Testing: (1;2) " + s12 + "\t" + c12 + "\n")
       out.write("Testing: (2;1) " + s21 + "\t" + c21 + "\n")
-      out.write("Discharging (1):")
-      out.write("\nNormal:    \t")
-      out.write(f1.toString)
-      out.write("\nSimplified:\t")
-      out.write(f1p.toString)
-      out.write("\n")
-      out.write("Valid:\t")
-      out.write(sat1 match {
-        case Some(x) => x.toString();
-        case None => "Unknown"
-      })
+      for ((f, v) <- checks.zip(valid))
+        out.write("Discharging: " + f + "\nValid:\t" + v.map(_.toString).getOrElse("Unknown") + "\n")
       out.write("\n")
-      out.write("Discharging (2):")
-      out.write("\nNormal:    \t")
-      out.write(f2.toString)
-      out.write("\nSimplified:\t")
-      out.write(f2p.toString)
-      out.write("\n")
-      out.write("Valid:\t")
-      out.write(sat2 match {
-        case Some(x) => x.toString();
-        case None => "Unknown"
-      })
-      if (model != null){
-        out.write("\n")
-        out.write("Model:\n")
-        out.write(model.toString)
-      }
-      //out.write("\n")
-      //out.write("Model:\n")
-      out.write("\n\n")
       out.flush()
     }
-    return sat2 match {
-      case Some(x) =>
-        // we must also look at sat1 here
-        sat1 match {
-          case Some(y) => x && y
-          case None => false
-        }
-      case None => false
+    // both checks of a direction have to be valid, one that is not valid decides it even if the other is unknown
+    def both(a: Option[Boolean], b: Option[Boolean]): Option[Boolean] = {
+      if (a == Some(false) || b == Some(false)) Some(false)
+      else if (a == Some(true) && b == Some(true)) Some(true)
+      else None
     }
+    val forwardRes = if (forward) Some(both(valid(0), valid(1))) else None
+    val backwardRes = if (backward) Some(if (forward) both(valid(2), valid(3)) else both(valid(0), valid(1))) else None
+    (forwardRes, backwardRes)
+  }
+
+  // a counter model of a failed check, projected onto the initial values of its variables (level 0)
+  private def LearnCounterModel(f: Formula, model: Z3ModelWrapper) {
+    val initial = FormulaHelpers.getVarsOfLevel(fm.extractVariablesS(f), 0)
+    val shift = 32 - fm.intWidth // values of a smaller width are sign extended
+    val state = for (v <- initial; value <- model.evalInt(fm.makeVariable(v))) yield (FormulaHelpers.filterVar(v), (value << shift) >> shift)
+    ConcreteExecution.learn(state.toMap)
   }
 }
\ No newline at end of file
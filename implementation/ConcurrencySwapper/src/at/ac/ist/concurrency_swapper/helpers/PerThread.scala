@@ -0,0 +1,40 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+// A value that is shared by all threads, except for threads that set their own.
+// The mover precomputation uses it to give every worker its own z3 context behind the usual singletons.
+class PerThread[T <: AnyRef] {
+  @volatile private var shared: T = _
+  private val local = new ThreadLocal[T]
+
+  def get: T = {
+    val l = local.get()
+    if (l != null) l else shared
+  }
+
+  def set(value: T, thisThreadOnly: Boolean) {
+    if (thisThreadOnly) local.set(value) else shared = value
+  }
+
+  def clearLocal() {
+    local.remove()
+  }
+}
@@ -0,0 +1,184 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.helpers
+
+import java.io._
+import java.security.MessageDigest
+import java.util.concurrent.atomic.AtomicInteger
+import java.util.regex.Matcher
+import collection.mutable
+import at.ac.ist.concurrency_swapper.translation.{TranslationChain, Down}
+
+// Mover results under keys that do not depend on statement numbers (ParallelAnalysis.Movers is keyed by them,
+// and they depend on the order in which the structures were created). A key is a hash of the exact SMT-LIB text of
+// the translated commands of both statement lists (which includes the lock and atomic expansion), the bit width, the
+// direction and the deadlock mode. Every result is stored under two keys: one of the text as it is and one with the
+// variables renamed canonically. So flag1 = 1 and flag2 = 1 share an entry, and so do repeated lock patterns.
+// The results are kept for the whole run and, if a filename is given, in a file: a magic number and the MD5 of the
+// encoding (see fingerprint) followed by one record per key, 16 bytes of MD5 and one byte for the answer. New
+// results are appended, a file written with another encoding is started over.
+object PersistentMoverCache {
+  var filename = "" // empty to keep the results in memory only
+  private val magic = 0x4d564333 // "MVC3"
+  private val digestLength = 16
+  // must be increased whenever the mover check itself changes (the translation is covered by the formulas in the key)
+  private val encodingVersion = 5
+
+  private var entries: mutable.HashMap[String, Boolean] = null
+  private var writer: DataOutputStream = null
+  val hits = new AtomicInteger(0) // answered under the exact key
+  val equivalentHits = new AtomicInteger(0) // answered by a query that only differs in variable names
+
+  case class Key(exact: String, renamed: String)
+
+  // a translated command as z3 prints it and its variable sets (e.g. the assigned and the used variables)
+  case class CommandText(text: String, variables: List[Set[String]])
+
+  // a token of the printed formula: a quoted symbol, or anything up to white space or a parenthesis
+  private val token = """\|[^|]*\||[^\s()|]+""".r
+  private val indexed = """(.*)@(\d+)""".r
+
+  // renames the variables (name@index) to v0, v1, ... in the order in which their names first occur, the index is
+  // kept as the composition of commands relies on it
+  private class Renaming {
+    private val names = new mutable.HashMap[String, String]
+
+    def variable(v: String): String = v match {
+      case indexed(name, index) => names.getOrElseUpdate(name, "v" + names.size) + "@" + index
+      case _ => v
+    }
+
+    def text(f: String): String = token.replaceAllIn(f, m => {
+      val t = m.matched.stripPrefix("|").stripSuffix("|")
+      Matcher.quoteReplacement(if (indexed.pattern.matcher(t).matches) variable(t) else m.matched)
+    })
+  }
+
+  private def exact(c: CommandText): String = (c.text :: c.variables.map(_.toList.sorted.mkString(" "))).mkString("\n")
+
+  // all texts are renamed before the variable sets, which are then sorted by their new names, so that the result
+  // does not depend on the original names
+  def canonical(commands: List[CommandText]): List[String] = {
+    val r = new Renaming
+    val texts = commands.map(c => r.text(c.text))
+    commands.zip(texts).map { case (c, t) =>
+      (t :: c.variables.map(vs => vs.toList.sorted.map(r.variable).sorted.mkString(" "))).mkString("\n")
+    }
+  }
+
+  def key(commands1: List[CommandText], commands2: List[CommandText], intWidth: Int, right: Boolean): Key = {
+    def digest(kind: String, f: List[String]) =
+      hex(md5(kind + "|" + Down.deadlockAnalysis + "|" + intWidth + "|" + right + "|" +
+        f.take(commands1.length).mkString("\n") + "\n||\n" + f.drop(commands1.length).mkString("\n")))
+    val all = commands1 ++ commands2
+    Key(digest("exact", all.map(exact)), digest("renamed", canonical(all)))
+  }
+
+  private def md5(s: String) = MessageDigest.getInstance("MD5").digest(s.getBytes("UTF-8"))
+
+  // results of another version of the mover check or another translation chain are not used
+  private def fingerprint = md5(encodingVersion + "|" +
+    (TranslationChain.intermediateChain ++ TranslationChain.finalChain).map(_.getClass.getName).mkString(","))
+
+  def get(key: Key): Option[Boolean] = synchronized {
+    load()
+    entries.get(key.exact) match {
+      case Some(res) =>
+        hits.incrementAndGet
+        Some(res)
+      case None =>
+        val res = entries.get(key.renamed)
+        if (res.isDefined) equivalentHits.incrementAndGet
+        res
+    }
+  }
+
+  def put(key: Key, result: Boolean) = synchronized {
+    load()
+    record(key.exact, result)
+    record(key.renamed, result)
+  }
+
+  private def record(key: String, result: Boolean) {
+    if (!entries.contains(key)) {
+      entries(key) = result
+      if (writer == null && !filename.isEmpty)
+        writer = new DataOutputStream(new BufferedOutputStream(new FileOutputStream(filename, true)))
+      if (writer != null) {
+        writer.write(key.grouped(2).map(Integer.parseInt(_, 16).toByte).toArray)
+        writer.writeByte(if (result) 1 else 0)
+      }
+    }
+  }
+
+  // writes what is still buffered and closes the file, the next new result opens it again
+  def close() = synchronized {
+    if (writer != null) {
+      writer.close()
+      writer = null
+    }
+  }
+
+  // the number of keys, every result is stored under two
+  def size = synchronized { if (entries == null) 0 else entries.size }
+
+  private def hex(bytes: Array[Byte]) = bytes.map("%02x" format _).mkString
+
+  private def load() {
+    if (entries != null) return
+    entries = new mutable.HashMap[String, Boolean]
+    if (filename.isEmpty) return
+    val file = new File(filename)
+    var valid = false
+    var records = 0
+    if (file.exists()) {
+      val in = new DataInputStream(new BufferedInputStream(new FileInputStream(file)))
+      try {
+        valid = in.readInt() == magic
+        if (valid) {
+          val header = new Array[Byte](digestLength)
+          in.readFully(header)
+          valid = java.util.Arrays.equals(header, fingerprint)
+        }
+        val record = new Array[Byte](digestLength)
+        while (valid) {
+          in.readFully(record)
+          val answer = in.readByte()
+          entries(hex(record)) = answer == 1
+          records += 1
+        }
+      } catch {
+        case e: EOFException => ()
+      } finally in.close()
+    }
+    if (valid) {
+      // cut off a record that was only partly written (e.g. because the run was killed)
+      val raf = new RandomAccessFile(file, "rw")
+      raf.setLength(4 + digestLength + records * (digestLength + 1))
+      raf.close()
+    } else
+      entries.clear() // an unknown or empty file is started over
+    writer = new DataOutputStream(new BufferedOutputStream(new FileOutputStream(file, valid)))
+    if (!valid) {
+      writer.writeInt(magic)
+      writer.write(fingerprint)
+    }
+  }
+}
@@ -19,7 +19,7 @@ You should have received a copy of the GNU General Public License
 
 package at.ac.ist.concurrency_swapper.helpers
 
-import ac.at.ist.concurrency_swapper.z3formulas.{Z3FormulaManager}
+import ac.at.ist.concurrency_swapper.z3formulas.{VarSet, Z3FormulaManager}
 import org.sosy_lab.common.LogManager
 import org.sosy_lab.common.configuration.Configuration
 import org.sosy_lab.common.configuration.InvalidConfigurationException
@@ -31,12 +31,13 @@ import org.sosy_lab.cpachecker.util.predicates.SSAMap.SSAMapBuilder
 import org.sosy_lab.cpachecker.exceptions.UnrecognizedCCodeException
 
 object StateFormula {
-  def Init(newFm: Z3FormulaManager, cpaConfig: Configuration, logManager: LogManager) {
-    fm = newFm
+  // the converters are built on the formula manager, so a thread with its own manager also gets its own converters
+  def Init(newFm: Z3FormulaManager, cpaConfig: Configuration, logManager: LogManager, thisThreadOnly: Boolean = false) {
     try {
-      efm = new ExtendedFormulaManager(fm, cpaConfig, logManager)
-      cto = new CtoFormulaConverter(cpaConfig, efm, logManager)
-      pfm = new PathFormulaManagerImpl(efm, cpaConfig, logManager)
+      val efm = new ExtendedFormulaManager(newFm, cpaConfig, logManager)
+      val cto = new CtoFormulaConverter(cpaConfig, efm, logManager)
+      val pfm = new PathFormulaManagerImpl(efm, cpaConfig, logManager)
+      converters.set(new Converters(newFm, cto, pfm), thisThreadOnly)
     }
     catch {
       case e: InvalidConfigurationException => {
@@ -46,12 +47,16 @@ object StateFormula {
   }
 
   def fromEdge(edge: CFAEdge): StateFormula = {
+    DirectEncoder.fromEdge(edge) match {
+      case Some(f) => return f
+      case None =>
+    }
     var pf: PathFormula = pfm.makeEmptyPathFormula
     pf = cto.makeAnd(pf, edge)
     var f: Formula = pf.getFormula
     //calculate min and shift everything up to min
-    if (fm.extractVariablesS(f) != Set.empty) {
-      val min = fm.extractVariablesS(f).map(FormulaHelpers.filterIndexInt).min
+    if (!fm.extractVariablesP(f).isEmpty) {
+      val min = fm.extractVariablesP(f).minIndex
       f = FormulaHelpers.shiftVariables(new StateFormula(f, 0, 3), -min, Set.empty)
       //make sure assignments end with 1
       f = FormulaHelpers.moveLastAssignment(f, 1)
@@ -66,21 +71,22 @@ object StateFormula {
     val newf2 = FormulaHelpers.shiftVariables(f2, shift)
     val newf2p: Formula = FormulaHelpers.stichFormulas(f1.getFormula, newf2)
     var newf = fm.makeAnd(f1.getFormula, newf2p)
-    val max = FormulaHelpers.getHighestIndex(fm.extractVariablesS(newf))
+    val max = FormulaHelpers.getHighestIndex(fm.extractVariablesP(newf))
     newf = FormulaHelpers.moveLastAssignment(newf, max)
 
-    // make and exists over the intermediate state
-    var vars: Set[String] = fm.extractVariablesS(newf)
-    vars --= FormulaHelpers.getVarsOfLevel(vars, 0)
-    vars --= FormulaHelpers.getHighestVars(vars)
-    val existsFormula: Formula = fm.makeExists(newf, vars)
-    return new StateFormula(existsFormula, f1.getLowerBound, FormulaHelpers.getHighestIndex(fm.extractVariablesS(existsFormula)))
+    // make and exists over the intermediate state, intermediate values that are assigned are substituted instead
+    var vars: VarSet = fm.extractVariablesP(newf)
+    vars --= vars.ofLevel(0)
+    vars --= vars.highest
+    val existsFormula: Formula = fm.makeExistsEliminating(newf, vars)
+    return new StateFormula(existsFormula, f1.getLowerBound, FormulaHelpers.getHighestIndex(fm.extractVariablesP(existsFormula)))
   }
 
-  private[concurrency_swapper] var fm: Z3FormulaManager = null
-  private var efm: ExtendedFormulaManager = null
-  private[concurrency_swapper] var cto: CtoFormulaConverter = null
-  private var pfm: PathFormulaManagerImpl = null
+  private class Converters(val fm: Z3FormulaManager, val cto: CtoFormulaConverter, val pfm: PathFormulaManagerImpl)
+  private val converters = new PerThread[Converters]
+  private[concurrency_swapper] def fm = converters.get.fm
+  private[concurrency_swapper] def cto = converters.get.cto
+  private def pfm = converters.get.pfm
 }
 
 class StateFormula {
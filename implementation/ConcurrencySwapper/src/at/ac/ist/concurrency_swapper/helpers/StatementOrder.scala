@@ -23,11 +23,15 @@ import org.sosy_lab.cpachecker.cfa.objectmodel.{CFAEdge, CFAFunctionDefinitionNo
 import collection.mutable
 import at.ac.ist.concurrency_swapper.structures._
 import collection.mutable.ListBuffer
+import at.ac.ist.concurrency_swapper.translation.Down
 
 object StatementOrder {
   type Statement = at.ac.ist.concurrency_swapper.structures.Statement
   type StmtConstraint = Constraint[Structure]
 
+  // an atomic section limits concurrency, so it counts as more expensive than a reordering
+  val atomicSectionCost = 5
+
   private def getPartialOrder(program:Program) : PartialOrder[Int] = {
     val res = new PartialOrder[Int]
     val mb = new mutable.MapBuilder[Int,Structure,Map[Int,Structure]](Map.empty) // we need that for printing
@@ -92,12 +96,21 @@ class StatementOrder(threads1 : List[(CFAFunctionDefinitionNode, String)],otherF
   private var program = PostParser.postParse(threads, otherFunctions, originalProgram)
   private var order = StatementOrder.getPartialOrder(program)
 
+  private var fixCost = 0 // the cost of all constraints integrated so far
+  private var history : List[StatementOrder.StmtConstraint] = List.empty // the constraints integrated so far
+
   def isOrdered(stmtNo1 : Int, stmtNo2 : Int) = order.isOrdered(stmtNo1, stmtNo2)
 
+  def getFixCost = fixCost
+  def getHistory = history
+  def getProgram = program
+
   def this(so: StatementOrder) {
     this(so.threads, so.otherFunctions, so.originalProgram)
     this.program = so.program.myClone()
     this.order = new PartialOrder[Int](so.order)
+    this.fixCost = so.fixCost
+    this.history = so.history
     PostParser.secondRound(this.program)
   }
 
@@ -143,11 +156,15 @@ class StatementOrder(threads1 : List[(CFAFunctionDefinitionNode, String)],otherF
         c match {
           case After(e1, e2) => {
             val so = new StatementOrder(this)
+            so.fixCost += 1
+            so.history = history ++ List(c)
             if (addOneConstraint(e2, e1, so))
               res += so
           }
           case PlaceAtomicSectionFunction(f) => {
             val so = new StatementOrder(this)
+            so.fixCost += StatementOrder.atomicSectionCost
+            so.history = history ++ List(c)
             if (addOneAtomicSec(f,so))
               res += so
           }
@@ -159,7 +176,42 @@ class StatementOrder(threads1 : List[(CFAFunctionDefinitionNode, String)],otherF
     return addConstraint(constraint)
   }
 
-  def printProgram(printType:PrintType.PrintType) : (String, Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) = {
+  // applies the constraints one after another, None if one of them cannot be integrated
+  def integrateAll(constraints: List[StatementOrder.StmtConstraint]): Option[StatementOrder] = {
+    var so : StatementOrder = this
+    for (c <- constraints) {
+      so.integrate(List(c)) match {
+        case List(next) => so = next
+        case _ => return None
+      }
+    }
+    Some(so)
+  }
+
+  // printed programs are kept because the pipeline stages candidates before they are checked
+  // the poirot output depends on the deadlock analysis, so that is part of the key
+  private var printed : Map[(PrintType.PrintType,Boolean), (String, Map[Int,List[(CFAEdge,StatementOrder.Statement)]])] = Map.empty
+
+  // prints the program in all forms so that it is ready when the model checker needs it
+  def stage() {
+    printProgram(PrintType.Normal)
+    printProgram(PrintType.Poirot)
+  }
+
+  def printProgram(printType:PrintType.PrintType) : (String, Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) = synchronized {
+    val key = (printType, Down.deadlockAnalysis)
+    printed.get(key) match {
+      case Some(res) => res
+      case None =>
+        val res = printUncached(printType)
+        // the pipeline stages in the background, if the mode changed meanwhile the result is not kept
+        if (Down.deadlockAnalysis == key._2)
+          printed += key -> res
+        res
+    }
+  }
+
+  private def printUncached(printType:PrintType.PrintType) : (String, Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) = {
     val map = new mutable.MapBuilder[Int, List[(CFAEdge,StatementOrder.Statement)], Map[Int, List[(CFAEdge,StatementOrder.Statement)]]](Map.empty)
 
     def addToMap(line:Int, newElement:(CFAEdge,StatementOrder.Statement)) = {
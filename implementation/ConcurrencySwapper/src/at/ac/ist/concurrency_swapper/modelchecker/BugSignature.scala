@@ -0,0 +1,44 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package at.ac.ist.concurrency_swapper.modelchecker
+
+import at.ac.ist.concurrency_swapper.helpers.Anchor
+import at.ac.ist.concurrency_swapper.structures.Statement
+
+// Identifies a bug by its structure instead of statement numbers, so the same bug is recognised in later
+// iterations, in the deadlock phase and in other files. An assertion failure is described by the failing
+// statement, the thread it fails in and the thread we switched from (the context switch that causes the bug).
+// Threads running the same function are told apart by their instance (their position among those threads).
+// A deadlock is described by the two locks involved.
+case class BugSignature(assertion: Anchor, thread: String, previousThread: String, threadInstance: Int = 0, previousInstance: Int = 0) {
+  private def instance(name: String, i: Int) = if (i == 0) name else name + "#" + i
+
+  override def toString = {
+    if (assertion.function.isEmpty) assertion.text // deadlock
+    else assertion.function + ": " + assertion.text + " (" + instance(previousThread, previousInstance) + " -> " + instance(thread, threadInstance) + ")"
+  }
+}
+
+object BugSignature {
+  def assertion(stmt: Statement, thread: (String, Int), previousThread: (String, Int)) =
+    BugSignature(Anchor.of(stmt), thread._1, previousThread._1, thread._2, previousThread._2)
+
+  def deadlock(lock: String, otherLock: String) = BugSignature(Anchor("", "deadlock " + lock + " " + otherLock), lock, otherLock)
+}
@@ -22,7 +22,7 @@ package at.ac.ist.concurrency_swapper.modelchecker
 import at.ac.ist.concurrency_swapper.helpers.StatementOrder
 
 trait InvokableChecker {
-  // it returns if there is a bug or not, if there is it also returns the trace and the id of the bug
-  // the id is used to determine if the bug is the same or if it is fixed
-  def invokeChecker(so: StatementOrder) : (Boolean, List[CtexStmt], Int, Double)
+  // it returns if there is a bug or not, if there is it also returns the trace and the signature of the bug
+  // the signature is used to determine if the bug is the same or if it is fixed
+  def invokeChecker(so: StatementOrder) : (Boolean, List[CtexStmt], BugSignature, Double)
 }
@@ -20,7 +20,7 @@ You should have received a copy of the GNU General Public License
 package at.ac.ist.concurrency_swapper.modelchecker.poirot
 
 import java.io._
-import at.ac.ist.concurrency_swapper.modelchecker.{CtexStmt, InvokableChecker}
+import at.ac.ist.concurrency_swapper.modelchecker.{BugSignature, CtexStmt, InvokableChecker}
 import at.ac.ist.concurrency_swapper.helpers.{ExpressionHelpers, PrintType, Helpers, StatementOrder}
 import java.util.regex.Pattern
 import scala.collection.mutable.ListBuffer
@@ -31,7 +31,12 @@ import at.ac.ist.concurrency_swapper.structures.{Statement, FunctionCallStatemen
 import at.ac.ist.concurrency_swapper.translation.{OtherLock, Down}
 import org.sosy_lab.cpachecker.cfa.objectmodel.CFAEdge
 
+// thrown when Poirot was stopped because the deadline passed
+class CheckerTimeout extends Exception("Poirot was stopped at the deadline")
+
 object InvokePoirot extends InvokableChecker{
+  // System.currentTimeMillis after which a running Poirot is stopped (0 means no deadline)
+  @volatile var deadline = 0L
 
   private class CtexLine(thread:Int, function:String, line:Int, addedLater:Boolean) {
     private var returnLines: List[Int] = List.empty
@@ -116,8 +121,20 @@ object InvokePoirot extends InvokableChecker{
     pb.redirectInput()
     pb.redirectError()
     val p = pb.start()
-    val out = Helpers.readToString(p.getInputStream)
-    val err = Helpers.readToString(p.getErrorStream)
+    // the output is read by two threads so that we can keep an eye on the deadline
+    var out = ""
+    var err = ""
+    val readers = List(
+      new Thread(new Runnable { def run() { out = Helpers.readToString(p.getInputStream) } }),
+      new Thread(new Runnable { def run() { err = Helpers.readToString(p.getErrorStream) } }))
+    readers.foreach(_.start())
+    while (readers.exists(_.isAlive)) {
+      if (deadline > 0 && System.currentTimeMillis > deadline) {
+        p.destroy()
+        throw new CheckerTimeout
+      }
+      readers.foreach(_.join(100))
+    }
 
     val exit = p.waitFor()
     return (out, err)
@@ -135,7 +152,20 @@ object InvokePoirot extends InvokableChecker{
   private val patternCallstack = Pattern.compile("(\\w+)\\|[^\\|]*\\.c\\|(\\d+)\\|")
   private val patternCommand = Pattern.compile("^(\\d+)\\s\\d+\\s\\d+\\s\\d+\\s(.+)")
 
-  private def parseCtex(statementmap: Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) : (List[CtexLine],Int) = {
+  // the thread function of a line in the trace is the outermost function on its call stack
+  private def threadName(l: CtexLine, statementmap: Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) : String = {
+    val line = if (l.getReturnLines.isEmpty) l.getLine else l.getReturnLines.last
+    if (statementmap.contains(line)) statementmap(line)(0)._2.getFunctionName() else l.getFunction
+  }
+
+  // the thread function of a line and which of the threads running that function it is (in the order of thread ids)
+  private def threadInstance(l: CtexLine, lines: List[CtexLine], statementmap: Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) : (String, Int) = {
+    val name = threadName(l, statementmap)
+    val threads = lines.filter(x => threadName(x, statementmap) == name).map(_.getThread).distinct.sorted
+    (name, math.max(0, threads.indexOf(l.getThread)))
+  }
+
+  private def parseCtex(statementmap: Map[Int,List[(CFAEdge,StatementOrder.Statement)]]) : (List[CtexLine],BugSignature) = {
     val lb = new ListBuffer[CtexLine]
     val ctexFile = new File("PoirotStage/corral_out_trace.txt")
     if (!ctexFile.exists)
@@ -143,6 +173,7 @@ object InvokePoirot extends InvokableChecker{
     val scanner = new Scanner(ctexFile)
 
     var bug:(CFAEdge,Statement) = null
+    var bugLine:CtexLine = null
     var bugThread = 0
     // we have to ignore the last line before a context switch or a
 
@@ -183,6 +214,7 @@ object InvokePoirot extends InvokableChecker{
             lastCtex.setIsAssertionFailure(true)
             lb += lastCtex
             bug = statementmap(lastCtex.getLine)(0)
+            bugLine = lastCtex
             bugThread = lastCtex.getThread
           }
           else if (command.startsWith("RETURN from") && !lb.result().isEmpty) {
@@ -206,16 +238,17 @@ object InvokePoirot extends InvokableChecker{
             case Some(name) =>
               // get the name of the other lock involved
               val otherlock = bug._1.asInstanceOf[OtherLock].getOtherLock
-              return (lb.result(),name.hashCode+otherlock.hashCode)
+              return (lb.result(),BugSignature.deadlock(name, otherlock))
           }
       }
     } else {
       // get thread trace
       val bugtrace = getThreadTrace(lb.result)
       if (bugtrace.length < 2)
-        return (null,0)
+        return (null,null)
       val prevThread = bugtrace(bugtrace.lastIndexOf(bugThread)-1)
-      return (lb.result(),bugThread.hashCode() + bug._2.getNumber.hashCode() + prevThread.hashCode())
+      val prevLine = lb.result().filter(_.getThread == prevThread).last
+      return (lb.result(),BugSignature.assertion(bug._2, threadInstance(bugLine, lb.result(), statementmap), threadInstance(prevLine, lb.result(), statementmap)))
     }
 
   }
@@ -266,10 +299,10 @@ object InvokePoirot extends InvokableChecker{
     new CtexStmt(statementmap(l.getLine).map(_._2),l.getReturnLines.map(statementmap(_)(0)._2),l.getThread,l.getIsAssertionFailure,l.getAddedLater)
   }
 
-  // it returns if there is a bug or not, if there is it also returns the trace and the id of the bug
-  // the id is used to determine if the bug is the same or if it is fixed
+  // it returns if there is a bug or not, if there is it also returns the trace and the signature of the bug
+  // the signature is used to determine if the bug is the same or if it is fixed
   // and we return the time we spend in poirot
-  def invokeChecker(so: StatementOrder):(Boolean, List[CtexStmt],Int,Double) = {
+  def invokeChecker(so: StatementOrder):(Boolean, List[CtexStmt],BugSignature,Double) = {
     createStage()
     val statementmap = printProgram(so)
     val startTime = new Date()
@@ -278,12 +311,12 @@ object InvokePoirot extends InvokableChecker{
     //println(out)
     //println(err)
     if (out.contains("Program has no bugs"))
-      return (true, List.empty,0, time)
+      return (true, List.empty,null, time)
     else
     {
       var (ctex, bugid) = parseCtex(statementmap)
       if (ctex == null)
-        return (false, null,0,time) // useless counterexample, dead end
+        return (false, null,null,time) // useless counterexample, dead end
       if (ctex.isEmpty)
         throw new Exception("no counter example generated")
       ctex = completeCtex(ctex, statementmap)
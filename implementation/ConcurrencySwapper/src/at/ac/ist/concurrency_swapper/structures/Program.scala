@@ -34,7 +34,14 @@ class Program(functions:List[Function], originalProgram:String, threadNames:Set[
     prog
   }
 
-  var declarationsForPoirot : Map[String,Int] = Map.empty
+  // statements are translated by several threads (precomputation, pipeline), so the declarations they add are synchronized
+  private var declarationsForPoirot : Map[String,Int] = Map.empty
+
+  def addDeclarationForPoirot(name:String, init:Int) = synchronized {
+    declarationsForPoirot += name -> init
+  }
+
+  def getDeclarationsForPoirot = synchronized { declarationsForPoirot }
 
   def getThreadNames = threadNames
   def getLockNames = lockNames
@@ -102,7 +109,7 @@ class Program(functions:List[Function], originalProgram:String, threadNames:Set[
     // now add the variable declarations
     val declsb = new StringBuilder
     val defsb = new StringBuilder
-    for ((name,init)<-declarationsForPoirot) {
+    for ((name,init)<-getDeclarationsForPoirot) {
       declsb.append("int " + name + " = " + init + "; ")
       defsb.append(name + " = " + init + "; ")
     }
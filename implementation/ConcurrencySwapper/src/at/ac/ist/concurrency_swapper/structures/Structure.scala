@@ -65,7 +65,8 @@ object Structure {
   }
 
   private var number = 0
-  def getNumber() = {
+  // synchronized as candidates are also printed by the pipeline thread
+  def getNumber() = synchronized {
     number += 1
     number
   }
@@ -109,6 +110,15 @@ abstract class Structure extends Cloneable {
     getFunctionLevel().getName()
   }
 
+  // gets the block (or call site) directly inside the function that contains this statement
+  // (a function or a structure outside of any function is its own block)
+  def getBlockLevel():Structure = {
+    var str = this
+    while (!str.isInstanceOf[Function] && str.getParent() != null && !str.getParent().isInstanceOf[Function])
+      str = str.getParent()
+    return str
+  }
+
   def getThreadName():String = {
     var str = this
     while (true) {
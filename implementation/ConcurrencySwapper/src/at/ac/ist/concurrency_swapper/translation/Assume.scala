@@ -42,7 +42,11 @@ object Assume extends FinalTranslation {
   def getFormula(edge: CFAEdge): GatedCommand = {
     var formula:Formula = null
     if (edge.getEdgeType eq CFAEdgeType.AssumeEdge) {
-      formula = FormulaHelpers.getFormula(edge.asInstanceOf[AssumeEdge].getExpression,edge.getPredecessor.getFunctionName)
+      val a = edge.asInstanceOf[AssumeEdge]
+      formula = FormulaHelpers.getFormula(a.getExpression,edge.getPredecessor.getFunctionName)
+      // the else branch of a condition assumes its negation (ConcreteExecution does the same)
+      if (!a.getTruthAssumption)
+        formula = FormulaHelpers.fm.makeNot(formula)
     } else {
       ExpressionHelpers.getFunctionDef(edge) match {
         case None => null
@@ -28,7 +28,7 @@ import at.ac.ist.concurrency_swapper.structures.Statement
 import collection.mutable.ListBuffer
 
 object Down extends IntermediateTranslation with VariableAnalysis {
-  var deadlockAnalysis = false;
+  @volatile var deadlockAnalysis = false; // changed by the main thread while the pipeline may be printing
 
   def accepts(edge: CFAEdge):Boolean = {
     isSem(edge) || isLock(edge)
@@ -59,7 +59,7 @@ object Down extends IntermediateTranslation with VariableAnalysis {
   private def addToInitList(name:String,originalStatement:Statement) = {
     if (originalStatement != null) {
       val p = originalStatement.getProgramLevel()
-      p.declarationsForPoirot += name -> 0
+      p.addDeclarationForPoirot(name, 0)
     }
   }
 
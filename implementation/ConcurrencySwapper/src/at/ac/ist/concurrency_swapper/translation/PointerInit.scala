@@ -41,7 +41,7 @@ object PointerInit extends IntermediateTranslation {
   override def translate(edge: CFAEdge,originalStatement:Statement): List[CFAEdge] = {
     val ass = edge.getRawAST.asInstanceOf[IASTExpressionAssignmentStatement]
     val id = ass.getLeftHandSide.asInstanceOf[IASTIdExpression]
-    originalStatement.getProgramLevel().declarationsForPoirot += id.getName+"_init" -> 0
+    originalStatement.getProgramLevel().addDeclarationForPoirot(id.getName+"_init", 0)
     return List(ExpressionHelpers.makeAssignmentEdge(id.getName+"_init", ExpressionHelpers.makeIntConst(1),originalStatement.getFunctionName()))
   }
 }
@@ -20,8 +20,9 @@ You should have received a copy of the GNU General Public License
 package at.ac.ist.concurrency_swapper.translation
 
 import org.sosy_lab.cpachecker.cfa.objectmodel.CFAEdge
-import at.ac.ist.concurrency_swapper.helpers.{VariableAnalysisResult, SomeVars, GatedCommand}
+import at.ac.ist.concurrency_swapper.helpers.{FormulaHelpers, VariableAnalysisResult, SomeVars, GatedCommand}
 import at.ac.ist.concurrency_swapper.structures.Statement
+import java.util.concurrent.ConcurrentHashMap
 
 object TranslationChain extends  VariableAnalysis {
   val finalChain : List[FinalTranslation] = List(AtomicEnd, AtomicStart, Assume, Assert, DefaultTranslation)
@@ -50,13 +51,60 @@ object TranslationChain extends  VariableAnalysis {
 
   def accepts(edge: CFAEdge) = true
 
+  // translated statements, kept as text so they survive recycling the z3 context and are shared by the worker threads
+  // the lock translation depends on the deadlock analysis and the formulas on the bit width, so both are in the key
+  private val formulas = new ConcurrentHashMap[(Int, Boolean, Int), GatedCommand.Stored]
+
+  // composed commands of statement groups, a group is built from the summary of its prefix and its last statement
+  private val summaries = new ConcurrentHashMap[(List[Int], Boolean, Int), GatedCommand.Stored]
+
+  def clearFormulas() {
+    formulas.clear()
+    summaries.clear()
+  }
+
   def getFormula(stmt:Statement): GatedCommand = {
+    val key = (stmt.getNumber, Down.deadlockAnalysis, FormulaHelpers.fm.intWidth)
+    val stored = formulas.get(key)
+    if (stored != null) {
+      try {
+        return GatedCommand.load(stored)
+      } catch {
+        case e: Exception => formulas.remove(key) // z3 could not read it back, so we translate again
+      }
+    }
+    val command = translateFormula(stmt)
+    formulas.put(key, GatedCommand.store(command))
+    return command
+  }
+
+  // the sequential composition of the statements, computed once per group
+  def getSummary(stmts:List[Statement]): GatedCommand = {
+    if (stmts.tail.isEmpty) return getFormula(stmts.head)
+    val key = (stmts.map(_.getNumber), Down.deadlockAnalysis, FormulaHelpers.fm.intWidth)
+    val stored = summaries.get(key)
+    if (stored != null) {
+      try {
+        return GatedCommand.load(stored)
+      } catch {
+        case e: Exception => summaries.remove(key)
+      }
+    }
+    val command = GatedCommand.SequentialComposition(getSummary(stmts.init), getFormula(stmts.last))
+    summaries.put(key, GatedCommand.store(command))
+    return command
+  }
+
+  private def translateFormula(stmt:Statement): GatedCommand = {
     val edge = stmt.getEdge
     val edges = applyIntermediate(edge,true,stmt)
     val gateds = edges.map(e => firstApplicable(finalChain, e) match { case Some(x) => x.getFormula(e); case None => throw new Exception("No applicable translation")})
     return gateds.tail.foldLeft(gateds.head)((s,x) => GatedCommand.SequentialComposition(s,x))
   }
 
+  // the edges getFormula translates, after the intermediate translations were applied
+  def formulaEdges(stmt:Statement): List[CFAEdge] = applyIntermediate(stmt.getEdge,true,stmt)
+
   def printEdge(stmt:Statement): String = {
     val edges = List(stmt.getEdge) // don't apply chain here
     val str = edges.map(e => firstApplicable(finalChain, e) match { case Some(x) => x.printEdge(e); case None => throw new Exception("No applicable translation")})
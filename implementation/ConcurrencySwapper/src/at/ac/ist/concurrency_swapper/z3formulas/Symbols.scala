@@ -0,0 +1,75 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package ac.at.ist.concurrency_swapper.z3formulas
+
+import java.util.concurrent.ConcurrentHashMap
+
+// The variables of the formulas are versioned names "name@index". The names are interned here and a variable is
+// passed around as a long that packs the name id (upper half) and the index (lower half), so the formula
+// manipulations neither split nor hash strings. Names without an index (like assumption literals) get index -1.
+object Symbols {
+  private val ids = new ConcurrentHashMap[String, Integer]
+  @volatile private var names: Array[String] = Array.empty // copied on write, so reading needs no lock
+  private val parsed = new ConcurrentHashMap[String, java.lang.Long]
+  private val printed = new ConcurrentHashMap[java.lang.Long, String]
+
+  def id(name: String): Int = {
+    val known = ids.get(name)
+    if (known != null) return known
+    synchronized {
+      val again = ids.get(name)
+      if (again != null)
+        again.intValue
+      else {
+        names = names :+ name
+        ids.put(name, names.length - 1)
+        names.length - 1
+      }
+    }
+  }
+
+  def name(id: Int): String = names(id)
+
+  def pack(id: Int, index: Int): Long = (id.toLong << 32) | (index & 0xffffffffL)
+  def nameId(v: Long): Int = (v >>> 32).toInt
+  def index(v: Long): Int = v.toInt
+  def withIndex(v: Long, index: Int): Long = pack(nameId(v), index)
+  def variable(name: String, index: Int): Long = pack(id(name), index)
+
+  // "name@index" -> packed variable, every string is only split once
+  def parse(s: String): Long = {
+    val known = parsed.get(s)
+    if (known != null) return known
+    val at = s.indexOf('@')
+    val v = if (at < 0) pack(id(s), -1) else pack(id(s.substring(0, at)), s.substring(at + 1).toInt)
+    parsed.put(s, v)
+    return v
+  }
+
+  // packed variable -> "name@index"
+  def toName(v: Long): String = {
+    val known = printed.get(v)
+    if (known != null) return known
+    val s = if (index(v) < 0) name(nameId(v)) else name(nameId(v)) + "@" + index(v)
+    printed.put(v, s)
+    parsed.put(s, v)
+    return s
+  }
+}
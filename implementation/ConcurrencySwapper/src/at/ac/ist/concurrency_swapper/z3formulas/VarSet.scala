@@ -0,0 +1,113 @@
+/*
+Copyright 2013 IST Austria
+
+This file is part of ConcurrencySwapper.
+
+ConcurrencySwapper is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ConcurrencySwapper is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+  along with ConcurrencySwapper. If not, see <http://www.gnu.org/licenses/>.
+  */
+
+package ac.at.ist.concurrency_swapper.z3formulas
+
+// An immutable set of packed variables (see Symbols) kept as a sorted array. Sorting groups the variables by
+// name and orders every name by index, which the SSA helpers use.
+final class VarSet private (private val vars: Array[Long]) {
+  def isEmpty: Boolean = vars.length == 0
+  def size: Int = vars.length
+  def contains(v: Long): Boolean = java.util.Arrays.binarySearch(vars, v) >= 0
+
+  def foreach(f: Long => Unit) {
+    var i = 0
+    while (i < vars.length) {
+      f(vars(i))
+      i += 1
+    }
+  }
+
+  def filter(p: Long => Boolean): VarSet = new VarSet(vars.filter(p))
+  def withFilter(p: Long => Boolean): VarSet = filter(p)
+  def map(f: Long => Long): VarSet = VarSet(vars.map(f))
+  def toSeq: Seq[Long] = vars.toSeq
+
+  def ++(other: VarSet): VarSet = {
+    if (other.isEmpty) return this
+    if (isEmpty) return other
+    val res = new Array[Long](vars.length + other.vars.length)
+    var i = 0
+    var j = 0
+    var n = 0
+    while (i < vars.length || j < other.vars.length) {
+      val next = if (j >= other.vars.length || (i < vars.length && vars(i) <= other.vars(j))) vars(i) else other.vars(j)
+      if (i < vars.length && vars(i) == next) i += 1
+      if (j < other.vars.length && other.vars(j) == next) j += 1
+      res(n) = next
+      n += 1
+    }
+    return new VarSet(java.util.Arrays.copyOf(res, n))
+  }
+
+  def --(other: VarSet): VarSet = {
+    if (isEmpty || other.isEmpty) return this
+    return new VarSet(vars.filterNot(other.contains))
+  }
+
+  def ofLevel(level: Int): VarSet = filter(Symbols.index(_) == level)
+
+  // for every name the variable with the highest index
+  def highest: VarSet = {
+    val res = new Array[Long](vars.length)
+    var n = 0
+    for (i <- 0 until vars.length) {
+      if (i + 1 == vars.length || Symbols.nameId(vars(i + 1)) != Symbols.nameId(vars(i))) {
+        res(n) = vars(i)
+        n += 1
+      }
+    }
+    return new VarSet(java.util.Arrays.copyOf(res, n))
+  }
+
+  def minIndex: Int = vars.map(Symbols.index).min
+  def maxIndex: Int = vars.map(Symbols.index).max
+
+  def toNames: Set[String] = vars.map(Symbols.toName).toSet
+
+  override def equals(other: Any): Boolean = other match {
+    case o: VarSet => java.util.Arrays.equals(vars, o.vars)
+    case _ => false
+  }
+
+  override def hashCode: Int = java.util.Arrays.hashCode(vars)
+
+  override def toString: String = vars.map(Symbols.toName).mkString("{", ", ", "}")
+}
+
+object VarSet {
+  val empty = new VarSet(Array.empty)
+
+  def apply(vars: Array[Long]): VarSet = {
+    if (vars.length == 0) return empty
+    val sorted = vars.clone()
+    java.util.Arrays.sort(sorted)
+    var n = 1
+    for (i <- 1 until sorted.length)
+      if (sorted(i) != sorted(n - 1)) {
+        sorted(n) = sorted(i)
+        n += 1
+      }
+    return new VarSet(if (n == sorted.length) sorted else java.util.Arrays.copyOf(sorted, n))
+  }
+
+  def single(v: Long): VarSet = new VarSet(Array(v))
+
+  def fromNames(names: Iterable[String]): VarSet = apply(names.map(Symbols.parse).toArray)
+}
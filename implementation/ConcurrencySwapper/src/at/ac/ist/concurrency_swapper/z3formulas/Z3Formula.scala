@@ -27,22 +27,27 @@ import z3.scala.Z3NumeralAST
 import z3.scala.Z3IntSymbol
 import scala.Some
 
-class Z3Formula(ast: Z3AST, context: Z3Context, assignedVariables: Set[String], usedVariables: Set[String]) extends Formula {
+class Z3Formula(ast: Z3AST, context: Z3Context, assignedVariables: VarSet, usedVariables: VarSet) extends Formula {
 
   def getTerm: Z3AST = {
     return this.ast
   }
 
+  // the variables packed (see Symbols)
+  lazy val variables: VarSet = assignedVariables ++ usedVariables
+  def assigned: VarSet = assignedVariables
+  def used: VarSet = usedVariables
+
   def getVariables: Set[String] = {
-    return this.assignedVariables ++ this.usedVariables
+    return variables.toNames
   }
 
   def getAssignedVariables: Set[String] = {
-    return this.assignedVariables
+    return assignedVariables.toNames
   }
 
   def getUsedVariables: Set[String] = {
-    return this.usedVariables
+    return usedVariables.toNames
   }
 
   def isTrue: Boolean = {
@@ -54,7 +59,7 @@ class Z3Formula(ast: Z3AST, context: Z3Context, assignedVariables: Set[String],
 
   def isFalse: Boolean = {
     context.getBoolValue(getTerm) match {
-      case Some(x) => return x
+      case Some(x) => return !x
       case None => return false
     }
   }
@@ -29,28 +29,38 @@ import scala.Some
 class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
   private var z3: Z3Context = z3ctx
   private final val INDEX_SEPARATOR: String = "@"
-  final def intSort : Z3Sort = z3.mkBVSort(32) //use 32 bit wide machine integers for z3
+  var intWidth = 32 // machine integers are 32 bit, a smaller width is only used for cheap tries (see ParallelAnalysis)
+  final def intSort : Z3Sort = z3.mkBVSort(intWidth)
   final def boolSort : Z3Sort = z3.mkBoolSort()
   private def defaultSort : Z3Sort = intSort
+  // serialize needs SMT-LIB 2 output, the mode is set once for the context so that every other printout
+  // (e.g. the formula log) looks the same all the time
+  z3.setAstPrintMode(Z3Context.AstPrintMode.Z3_PRINT_SMTLIB2_COMPLIANT)
 
-  def setZ3(z3ctx:Z3Context) { z3 = z3ctx }
+  def setZ3(z3ctx:Z3Context) {
+    z3 = z3ctx
+    z3.setAstPrintMode(Z3Context.AstPrintMode.Z3_PRINT_SMTLIB2_COMPLIANT)
+    trueFormula = null
+    falseFormula = null
+    simplified.clear()
+  }
   def getZ3() = z3
 
   private def makeName(name: String, idx: Int): String = {
-    return name + INDEX_SEPARATOR + idx
+    return Symbols.toName(Symbols.variable(name, idx)) // the same as name + INDEX_SEPARATOR + idx, but interned
   }
 
-  private def encapsulate(ast: Z3AST, assignedVariables: Set[String], usedVariables: Set[String]): Formula = {
+  private def encapsulate(ast: Z3AST, assignedVariables: VarSet, usedVariables: VarSet): Formula = {
     val newast = ast
     return new Z3Formula(newast, z3, assignedVariables, usedVariables)
   }
 
   private def encapsulate(ast: Z3AST): Formula = {
-    return encapsulate(ast, (Set.empty:Set[String]), (Set.empty:Set[String]))
+    return encapsulate(ast, VarSet.empty, VarSet.empty)
   }
 
   private def encapsulate(ast: Z3AST, newVar: String): Formula = {
-    return encapsulate(ast, (Set.empty:Set[String]), Set.empty + newVar)
+    return encapsulate(ast, VarSet.empty, VarSet.single(Symbols.parse(newVar)))
   }
 
   private def encapsulate(ast: Z3AST, oldFormula: Formula): Formula = {
@@ -58,8 +68,8 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
   }
 
   private def encapsulate(ast: Z3AST, oldFormula1: Formula, oldFormula2: Formula): Formula = {
-    val usedVars: Set[String] = getUsedVariables(oldFormula1) ++ getUsedVariables(oldFormula2)
-    val assignedVars: Set[String] = getAssignedVariables(oldFormula1) ++ getAssignedVariables(oldFormula2)
+    val usedVars: VarSet = getUsedVariables(oldFormula1) ++ getUsedVariables(oldFormula2)
+    val assignedVars: VarSet = getAssignedVariables(oldFormula1) ++ getAssignedVariables(oldFormula2)
     return encapsulate(ast, assignedVars, usedVars)
   }
 
@@ -67,65 +77,100 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
     return (f.asInstanceOf[Z3Formula]).getTerm
   }
 
-  private def getVariables(f: Formula): Set[String] = {
-    return (f.asInstanceOf[Z3Formula]).getVariables
+  private def getVariables(f: Formula): VarSet = {
+    return (f.asInstanceOf[Z3Formula]).variables
   }
 
-  private def getAssignedVariables(f: Formula): Set[String] = {
-    return (f.asInstanceOf[Z3Formula]).getAssignedVariables
+  private def getAssignedVariables(f: Formula): VarSet = {
+    return (f.asInstanceOf[Z3Formula]).assigned
   }
 
-  private def getUsedVariables(f: Formula): Set[String] = {
-    return (f.asInstanceOf[Z3Formula]).getUsedVariables
+  private def getUsedVariables(f: Formula): VarSet = {
+    return (f.asInstanceOf[Z3Formula]).used
   }
 
   def extractAssignedVariables(f: Formula): Set[String] = {
-    getAssignedVariables(f)
+    getAssignedVariables(f).toNames
   }
 
   def extractUsedVariables(f: Formula): Set[String] = {
-    getUsedVariables(f)
+    getUsedVariables(f).toNames
   }
 
+  // the variables packed (see Symbols), this is what the SSA helpers work on
+  def extractVariablesP(f: Formula): VarSet = getVariables(f)
+  def extractAssignedVariablesP(f: Formula): VarSet = getAssignedVariables(f)
+  def extractUsedVariablesP(f: Formula): VarSet = getUsedVariables(f)
+
   def isBoolean(pF: Formula): Boolean = {
     val sort = z3.getSort(getTerm(pF))
     sort.isBoolSort
   }
 
+  // The boolean connectives are rewritten before z3 builds a term: constants are folded, and trivial implications
+  // and equalities are dropped. The variable sets of both sides are still joined, so the SSA bookkeeping is the
+  // same as for the full term. z3 already shares structurally equal terms, so the only thing we remember is what
+  // simplify made of a term (per context, see setZ3).
+  private var trueFormula: Formula = null
+  private var falseFormula: Formula = null
+  private val simplified = new java.util.HashMap[Z3AST, Z3AST]
+  private val maxSimplified = 100000
+
   def simplify(f: Formula) : Formula = {
-    encapsulate(z3.simplifyAst(getTerm(f)), f)
+    var res = simplified.get(getTerm(f))
+    if (res == null) {
+      res = z3.simplifyAst(getTerm(f))
+      if (simplified.size >= maxSimplified) simplified.clear()
+      simplified.put(getTerm(f), res)
+      simplified.put(res, res)
+    }
+    encapsulate(res, f)
   }
 
   def makeTrue: Formula = {
-    return encapsulate(z3.mkTrue)
+    if (trueFormula == null) trueFormula = encapsulate(z3.mkTrue)
+    return trueFormula
   }
 
   def makeFalse: Formula = {
-    return encapsulate(z3.mkFalse)
+    if (falseFormula == null) falseFormula = encapsulate(z3.mkFalse)
+    return falseFormula
   }
 
+  private def sameTerm(f1: Formula, f2: Formula): Boolean = getTerm(f1) == getTerm(f2)
+
   def makeNot(f: Formula): Formula = {
+    if (f.isTrue) return encapsulate(getTerm(makeFalse), f)
+    if (f.isFalse) return encapsulate(getTerm(makeTrue), f)
     return encapsulate(z3.mkNot(getTerm(f)), f)
   }
 
   def makeAnd(f1: Formula, f2: Formula): Formula = {
+    if (f1.isTrue || f2.isFalse) return encapsulate(getTerm(f2), f1, f2)
+    if (f2.isTrue || f1.isFalse || sameTerm(f1, f2)) return encapsulate(getTerm(f1), f1, f2)
     return encapsulate(z3.mkAnd(getTerm(f1), getTerm(f2)),f1 ,f2)
   }
 
   def makeOr(f1: Formula, f2: Formula): Formula = {
+    if (f1.isFalse || f2.isTrue) return encapsulate(getTerm(f2), f1, f2)
+    if (f2.isFalse || f1.isTrue || sameTerm(f1, f2)) return encapsulate(getTerm(f1), f1, f2)
     return encapsulate(z3.mkOr(getTerm(f1), getTerm(f2)), f1, f2)
   }
 
   def makeImplies(f1: Formula, f2: Formula): Formula = {
+    if (f1.isTrue || f2.isTrue) return encapsulate(getTerm(f2), f1, f2)
+    if (f1.isFalse || sameTerm(f1, f2)) return encapsulate(getTerm(makeTrue), f1, f2)
     return encapsulate(z3.mkImplies(getTerm(f1), getTerm(f2)), f1, f2)
   }
 
   def makeEquivalence(f1: Formula, f2: Formula): Formula = {
+    if (sameTerm(f1, f2)) return encapsulate(getTerm(makeTrue), f1, f2)
     return encapsulate(z3.mkIff(getTerm(f1), getTerm(f2)), f1, f2)
   }
 
   def makeIfThenElse(cond: Formula, f1: Formula, f2: Formula): Formula = {
-    return encapsulate(z3.mkITE(getTerm(cond), getTerm(f1), getTerm(f2)), f1, f2)
+    val ast = z3.mkITE(getTerm(cond), getTerm(f1), getTerm(f2))
+    return encapsulate(ast, encapsulate(ast, f1, f2), cond) // the variables of the condition count as well
   }
 
   def makeNumber(pI: Int): Formula = {
@@ -161,6 +206,7 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
   }
 
   def makeEqual(pF1: Formula, pF2: Formula): Formula = {
+    if (sameTerm(pF1, pF2)) return encapsulate(getTerm(makeTrue), pF1, pF2)
     return encapsulate(z3.mkEq(getTerm(pF1), getTerm(pF2)), pF1, pF2)
   }
 
@@ -238,6 +284,10 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
     z3.mkConst(z3.mkStringSymbol(pVar), sort)
   }
 
+  private def makeVariableAST(v: Long): Z3AST = {
+    makeVariableAST(Symbols.toName(v), defaultSort)
+  }
+
   def makePredicateVariable(pVar: String, pIdx: Int): Formula = {
     throw new UnsupportedOperationException("Not yet implemented")
   }
@@ -266,13 +316,120 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
   }
 
   def makeExists(f: Formula, vars : Set[String], weight : Int = 1) : Formula = {
-    val vars2 = vars.map(x => makeVariableAST(x))
-    return encapsulate(z3.mkExistsConst(weight, Seq.empty, vars2.toSeq, getTerm(f)), getAssignedVariables(f) -- vars, getUsedVariables(f) -- vars);
+    return makeExistsP(f, VarSet.fromNames(vars), weight)
   }
 
   def makeForall(f: Formula, vars : Set[String], weight : Int = 1) : Formula = {
-    val varsp = vars.map(x => makeVariableAST(x))
-    return encapsulate(z3.mkForAllConst(weight, Seq.empty, varsp.toSeq, getTerm(f)), getAssignedVariables(f) -- vars, getUsedVariables(f) -- vars);
+    return makeForallP(f, VarSet.fromNames(vars), weight)
+  }
+
+  def makeExistsP(f: Formula, vars : VarSet, weight : Int = 1) : Formula = {
+    val vars2 = vars.toSeq.map(x => makeVariableAST(x))
+    return encapsulate(z3.mkExistsConst(weight, Seq.empty, vars2, getTerm(f)), getAssignedVariables(f) -- vars, getUsedVariables(f) -- vars);
+  }
+
+  // ∃vars. f, but every variable that f defines by a top level equality v = e (v not in e) is replaced by e
+  // instead of quantified, so for assignments the result has no quantifier at all
+  def makeExistsEliminating(f: Formula, vars : VarSet) : Formula = {
+    val (conjuncts, _, remaining, eliminated) = eliminateDefinitions(conjunctsOf(getTerm(f)), Seq.empty, vars)
+    if (eliminated.isEmpty)
+      return makeExistsP(f, vars)
+    val res = encapsulate(conjunction(conjuncts), getAssignedVariables(f) -- eliminated, getUsedVariables(f) -- eliminated)
+    if (remaining.isEmpty)
+      return res
+    return makeExistsP(res, remaining)
+  }
+
+  // ∀vars. tau ⇒ phi, the same way: the variables tau defines are substituted in the rest of tau and in phi, so
+  // for deterministic commands this is the weakest precondition by substitution
+  def makeForallImpliesEliminating(tau: Formula, phi: Formula, vars : VarSet) : Formula = {
+    val (conjuncts, others, remaining, eliminated) = eliminateDefinitions(conjunctsOf(getTerm(tau)), Seq(getTerm(phi)), vars)
+    if (eliminated.isEmpty)
+      return makeForallP(makeImplies(tau, phi), vars)
+    val body = if (conjuncts.isEmpty) others.head else z3.mkImplies(conjunction(conjuncts), others.head)
+    val res = encapsulate(body, (getAssignedVariables(tau) ++ getAssignedVariables(phi)) -- eliminated,
+      (getUsedVariables(tau) ++ getUsedVariables(phi)) -- eliminated)
+    if (remaining.isEmpty)
+      return res
+    return makeForallP(res, remaining)
+  }
+
+  // substitutes the definitions among the conjuncts of the variables in vars (in the other conjuncts and in others)
+  // and returns the conjuncts and others that are left, the variables that are still free and the eliminated ones
+  private def eliminateDefinitions(conjuncts: Seq[Z3AST], others: Seq[Z3AST], vars: VarSet) : (Seq[Z3AST], Seq[Z3AST], VarSet, VarSet) = {
+    var cs = conjuncts
+    var os = others
+    var remaining = vars
+    var eliminated = VarSet.empty
+    var defined = definition(cs, remaining)
+    while (defined != None) {
+      val (i, v, e) = defined.get
+      val va = Array(makeVariableAST(v))
+      cs = (cs.take(i) ++ cs.drop(i + 1)).map(c => z3.substitute(c, va, Array(e)))
+      os = os.map(o => z3.substitute(o, va, Array(e)))
+      remaining --= VarSet.single(v)
+      eliminated ++= VarSet.single(v)
+      defined = definition(cs, remaining)
+    }
+    return (cs, os, remaining, eliminated)
+  }
+
+  private def conjunction(conjuncts: Seq[Z3AST]): Z3AST = {
+    if (conjuncts.isEmpty) z3.mkTrue else if (conjuncts.length == 1) conjuncts.head else z3.mkAnd(conjuncts: _*)
+  }
+
+  private def conjunctsOf(ast: Z3AST): Seq[Z3AST] = {
+    z3.getASTKind(ast) match {
+      case Z3AppAST(fun, args) if z3.getDeclKind(fun) == Z3DeclKind.OpAnd => args.flatMap(conjunctsOf)
+      case _ => Seq(ast)
+    }
+  }
+
+  // the first conjunct that is an equality v = e (or e = v) with v in vars and not in e
+  private def definition(conjuncts: Seq[Z3AST], vars: VarSet): Option[(Int, Long, Z3AST)] = {
+    for ((c, i) <- conjuncts.zipWithIndex) {
+      z3.getASTKind(c) match {
+        case Z3AppAST(fun, Seq(a, b)) if z3.getDeclKind(fun) == Z3DeclKind.OpEq =>
+          for ((lhs, rhs) <- List((a, b), (b, a))) {
+            variableOf(lhs) match {
+              case Some(v) if vars.contains(v) && !occurs(lhs, rhs) => return Some((i, v, rhs))
+              case _ =>
+            }
+          }
+        case _ =>
+      }
+    }
+    return None
+  }
+
+  private def variableOf(ast: Z3AST): Option[Long] = {
+    z3.getASTKind(ast) match {
+      case Z3AppAST(fun, args) if args.isEmpty && z3.getDeclKind(fun) == Z3DeclKind.OpUninterpreted =>
+        z3.getSymbolKind(fun.getName) match {
+          case Z3StringSymbol(s) => Some(Symbols.parse(s))
+          case _ => None
+        }
+      case _ => None
+    }
+  }
+
+  private def occurs(v: Z3AST, ast: Z3AST): Boolean = {
+    val visited = new scala.collection.mutable.HashSet[Z3AST]
+    def visit(a: Z3AST): Boolean = {
+      if (a == v) return true
+      if (!visited.add(a)) return false
+      z3.getASTKind(a) match {
+        case Z3AppAST(_, args) => args.exists(visit)
+        case Z3QuantifierAST(_, _, body) => visit(body)
+        case _ => false
+      }
+    }
+    return visit(ast)
+  }
+
+  def makeForallP(f: Formula, vars : VarSet, weight : Int = 1) : Formula = {
+    val varsp = vars.toSeq.map(x => makeVariableAST(x))
+    return encapsulate(z3.mkForAllConst(weight, Seq.empty, varsp, getTerm(f)), getAssignedVariables(f) -- vars, getUsedVariables(f) -- vars);
   }
 
   def parseInfix(s: String): Formula = {
@@ -283,6 +440,18 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
     encapsulate(z3.parseSMTLIB2String(s))
   }
 
+  // a textual form of the formula that does not depend on this context, see deserialize
+  def serialize(f: Formula): SerializedFormula = {
+    return new SerializedFormula(z3.astToString(getTerm(f)), getAssignedVariables(f).toNames, getUsedVariables(f).toNames)
+  }
+
+  // reads a serialized formula into this context, all free symbols are variables of the default sort (intSort)
+  def deserialize(s: SerializedFormula): Formula = {
+    val decls = (s.assignedVariables ++ s.usedVariables).map(v => "(declare-fun |" + v + "| () (_ BitVec " + intWidth + "))")
+    return encapsulate(z3.parseSMTLIB2String(decls.mkString("\n") + "\n(assert " + s.smt + ")"),
+      VarSet.fromNames(s.assignedVariables), VarSet.fromNames(s.usedVariables))
+  }
+
   def instantiate(f: Formula, ssa: SSAMap): Formula = {
     throw new UnsupportedOperationException("Not yet implemented")
   }
@@ -296,7 +465,7 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
   }
 
   def extractVariablesS(f: Formula): Set[String] = {
-    return getVariables(f)
+    return getVariables(f).toNames
   }
 
   def extractVariables(f: Formula): java.util.Set[String] = {
@@ -320,14 +489,22 @@ class Z3FormulaManager(z3ctx : Z3Context) extends FormulaManager {
   }
 
   def replace(pF: Formula, oldNames:Array[String], newNames:Array[String]): Formula = {
-    encapsulate(z3.substitute(getTerm(pF), oldNames.map(makeVariableAST(_)), newNames.map(makeVariableAST(_))),
-    Z3Helper.setReplace[String](getAssignedVariables(pF), oldNames, newNames), Z3Helper.setReplace[String](getUsedVariables(pF), oldNames, newNames))
+    rename(pF, oldNames.map(Symbols.parse).zip(newNames.map(Symbols.parse)).toMap)
+  }
+
+  // renames all variables of the mapping simultaneously in one substitution
+  def rename(pF: Formula, mapping: Map[Long, Long]): Formula = {
+    if (mapping.isEmpty) return pF
+    val (oldVars, newVars) = mapping.toSeq.unzip
+    val renamed = (v: Long) => mapping.getOrElse(v, v)
+    encapsulate(z3.substitute(getTerm(pF), oldVars.map(makeVariableAST(_)).toArray, newVars.map(makeVariableAST(_)).toArray),
+    getAssignedVariables(pF).map(renamed), getUsedVariables(pF).map(renamed))
   }
 
   def makeValid(f: Formula) : Formula = {
-    if (getVariables(f) == Set.empty)
+    if (getVariables(f).isEmpty)
       return f
-    return makeForall(f, getVariables(f))
+    return makeForallP(f, getVariables(f))
   }
 
 }
\ No newline at end of file
@@ -20,9 +20,15 @@ You should have received a copy of the GNU General Public License
 package ac.at.ist.concurrency_swapper.z3formulas
 
 import org.sosy_lab.cpachecker.util.predicates.Model
+import org.sosy_lab.cpachecker.util.predicates.interfaces.Formula
 import z3.scala.Z3Model
 
 class Z3ModelWrapper(fm : Z3FormulaManager, model : Z3Model) {
+  // the value of an integer (bit vector) term in this model, None if the model does not fix it
+  def evalInt(f: Formula) : Option[Int] = {
+    model.evalAs[Int](f.asInstanceOf[Z3Formula].getTerm)
+  }
+
   override def toString() : String = {
     return model.toString()
   }
@@ -28,6 +28,39 @@ import org.sosy_lab.cpachecker.util.predicates.interfaces.TheoremProver
 import z3.scala._
 import java.lang
 import scala.Some
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.atomic.AtomicInteger
+import collection.mutable
+
+// Validity checks go through a portfolio of tactic pipelines (tactic names joined by ","). The pipelines are tried
+// one after the other with a timeout each; the checks none of them decided are tried again with twice the timeout
+// until maxTimeoutMs is exceeded. All attempts of one call of areValid together take at most budgetMs, the last
+// attempt gets what is left of it. A check that is still open is reported as unknown.
+object Z3TheoremProver {
+  var quantifierFreeStrategies = List("qfbv", "smt", "simplify,bit-blast,sat")
+  var quantifiedStrategies = List("qe,smt", "smt")
+  var timeoutMs = 10000 // 0 means no timeout and no escalation
+  var maxTimeoutMs = 160000
+  var budgetMs = 60000 // for all attempts of one call of areValid, only used with a timeout
+
+  // how many checks every pipeline decided ("unknown" for the ones nobody decided)
+  val wins = new ConcurrentHashMap[String, AtomicInteger]
+
+  private def won(strategy: String) {
+    wins.putIfAbsent(strategy, new AtomicInteger(0))
+    wins.get(strategy).incrementAndGet
+  }
+
+  def statistics: String = {
+    import scala.collection.JavaConversions._
+    wins.toSeq.sortBy(_._1).map(x => x._1 + ": " + x._2.get).mkString(", ")
+  }
+
+  private def timeouts: List[Int] = {
+    if (timeoutMs <= 0) return List(0)
+    Iterator.iterate(timeoutMs)(_ * 2).takeWhile(_ <= math.max(timeoutMs, maxTimeoutMs)).toList
+  }
+}
 
 class Z3TheoremProver(z3: Z3Context) extends TheoremProver {
 
@@ -51,13 +84,129 @@ class Z3TheoremProver(z3: Z3Context) extends TheoremProver {
     solver = z3.mkSolverFromTactic(tactic)
   }
 
+  // the solver of a pipeline with the given timeout, they are built when first needed
+  private def strategySolver(pipeline: String, timeout: Int): Z3Solver = {
+    strategySolvers.getOrElseUpdate((pipeline, timeout), {
+      val names = pipeline.split(",").map(_.trim)
+      var t = z3.mkTactic(names.head)
+      for (n <- names.tail) {
+        val next = z3.mkTactic(n)
+        val both = z3.mkTacticAndThen(t, next)
+        t.delete()
+        next.delete()
+        t = both
+      }
+      if (timeout > 0) {
+        val limited = z3.mkTacticTryFor(t, timeout)
+        t.delete()
+        t = limited
+      }
+      (t, z3.mkSolverFromTactic(t))
+    })._2
+  }
+
   def push(f: Formula) {
     solver.push
+    scopes += 1
     solver.assertCnstr(getTerm(f))
   }
 
   def pop {
     solver.pop(1)
+    scopes -= 1
+  }
+
+  // the number of open scopes (including those of the strategy solvers), the solvers are only clean when this is 0
+  def scopeDepth = scopes
+
+  // frees the solver and the tactic, the prover cannot be used afterwards
+  def delete() {
+    solver.delete()
+    tactic.delete()
+    for ((t, s) <- strategySolvers.values) {
+      s.delete()
+      t.delete()
+    }
+    strategySolvers.clear()
+    solver = null
+    tactic = null
+  }
+
+  // Validity is checked as unsatisfiability of the negation with the variables left free, so no quantifiers from
+  // a universal closure have to be eliminated. Formulas without quantifiers use the quantifier free pipelines.
+  def isValid(f: Formula): Option[Boolean] = areValid(Seq(f)).head
+
+  // checks several formulas in one scope per pipeline: l_i ⇒ ¬f_i is asserted once and check i only assumes l_i
+  // counterModel is called with the model of every check that is not valid
+  def areValid(fs: Seq[Formula], counterModel: (Int, Z3ModelWrapper) => Unit = null): Seq[Option[Boolean]] = {
+    val pipelines =
+      if (fs.exists(f => hasQuantifier(getTerm(f)))) Z3TheoremProver.quantifiedStrategies
+      else Z3TheoremProver.quantifierFreeStrategies
+    // fresh literals, so a constraint left behind by a failed call can never be assumed by a later one
+    val literals = fs.indices.map(i => z3.mkFreshConst("validity_check", z3.mkBoolSort()))
+    val constraints = fs.zip(literals).map(x => z3.mkImplies(x._2, z3.mkNot(getTerm(x._1))))
+    val res = Array.fill[Option[Boolean]](fs.length)(None)
+    var open = fs.indices.toList
+    val deadline = System.currentTimeMillis + Z3TheoremProver.budgetMs
+    // the timeout of a check cut to what is left of the budget (in whole seconds, so few solvers are built),
+    // -1 once the budget is used up
+    def limited(timeout: Int): Int = {
+      if (timeout == 0) return 0
+      val left = (deadline - System.currentTimeMillis) / 1000 * 1000
+      if (left <= 0) -1 else math.min(timeout.toLong, left).toInt
+    }
+    for (timeout <- Z3TheoremProver.timeouts; pipeline <- pipelines; if !open.isEmpty) {
+      // the checks share one scope as long as their timeout stays the same, the scope is closed whatever happens
+      var s: Z3Solver = null
+      try {
+        for (i <- open) {
+          val t = limited(timeout)
+          if (t >= 0) {
+            val next = strategySolver(pipeline, t)
+            if (next ne s) {
+              if (s != null) {
+                s.pop(1)
+                scopes -= 1
+                s = null
+              }
+              next.push
+              scopes += 1
+              s = next
+              constraints.foreach(s.assertCnstr(_))
+            }
+            val sat = s.checkAssumptions(literals(i))
+            if (sat.isDefined) {
+              res(i) = negateOption(sat)
+              Z3TheoremProver.won(pipeline)
+              if (sat == Some(true) && counterModel != null)
+                counterModel(i, new Z3ModelWrapper(null, s.getModel()))
+            }
+          }
+        }
+      } finally {
+        if (s != null) {
+          s.pop(1)
+          scopes -= 1
+        }
+      }
+      open = open.filter(res(_) == None)
+    }
+    for (i <- open) Z3TheoremProver.won("unknown")
+    modelAvailable = false
+    return res.toSeq
+  }
+
+  private def hasQuantifier(ast: Z3AST): Boolean = {
+    val visited = new scala.collection.mutable.HashSet[Z3AST]
+    def visit(a: Z3AST): Boolean = {
+      if (!visited.add(a)) return false
+      z3.getASTKind(a) match {
+        case Z3QuantifierAST(_, _, _) => true
+        case Z3AppAST(_, args) => args.exists(visit)
+        case _ => false
+      }
+    }
+    return visit(ast)
   }
 
   def isUnsat: Boolean = {
@@ -100,7 +249,10 @@ class Z3TheoremProver(z3: Z3Context) extends TheoremProver {
     return new Z3ModelWrapper(null, solver.getModel())
   }
 
-  def reset() = solver.reset()
+  def reset() = {
+    solver.reset()
+    scopes = 0
+  }
 
   def allSat(f: Formula, important: Collection[Formula], mgr: AbstractionManager, timer: Timer): TheoremProver.AllSatResult = {
     return null
@@ -108,6 +260,8 @@ class Z3TheoremProver(z3: Z3Context) extends TheoremProver {
 
   private var solver: Z3Solver = null
   private var tactic: Z3Tactic = null
+  private val strategySolvers = new mutable.HashMap[(String, Int), (Z3Tactic, Z3Solver)]
   private var modelAvailable = false
+  private var scopes = 0
 }
 